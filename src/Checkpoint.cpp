@@ -0,0 +1,194 @@
+#include "Checkpoint.h"
+#include "MCMCChain.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdexcept>
+
+using namespace util;
+using namespace infect;
+using namespace lognormal;
+
+static const char magic[8] = {'B','T','C','H','E','C','K','\0'};
+static const uint32_t version = 4;
+
+void getCheckpoint(SystemHistory *hist, LogNormalModel *model, Random *random, Checkpoint &cp)
+{
+    if (!random->getState(cp.rng))
+        throw std::runtime_error("Checkpoints are not supported for " + random->className());
+
+    cp.params.clear();
+    for (int i=0; i<nModelComponents; i++)
+        cp.params.push_back(modelComponent(model,i)->getState());
+
+    cp.admit.clear();
+    cp.nsim.clear();
+    cp.times.clear();
+    cp.states.clear();
+    for (Map *e = hist->getEpisodes(); e->hasNext(); )
+    {
+        EpisodeHistory *eh = (EpisodeHistory *) e->nextValue();
+        cp.admit.push_back(eh->admissionTime());
+        cp.nsim.push_back(ConstrainedSimulator::getEpisodeState(model,eh,cp.times,cp.states));
+    }
+}
+
+void setCheckpoint(const Checkpoint &cp, SystemHistory *hist, Sampler *mc, LogNormalModel *model, Random *random)
+{
+    if (cp.params.size() != (size_t) nModelComponents)
+        throw std::runtime_error("Checkpoint does not match the model");
+
+    // Check that the episodes line up before changing anything.
+    size_t k = 0;
+    for (Map *e = hist->getEpisodes(); e->hasNext(); k++)
+    {
+        EpisodeHistory *eh = (EpisodeHistory *) e->nextValue();
+        if (k >= cp.admit.size() || cp.admit[k] != eh->admissionTime())
+            throw std::runtime_error("Checkpoint does not match the data");
+    }
+    if (k != cp.admit.size())
+        throw std::runtime_error("Checkpoint does not match the data");
+
+    for (int i=0; i<nModelComponents; i++)
+        modelComponent(model,i)->setState(cp.params[i]);
+
+    std::vector<double> times = cp.times;
+    std::vector<int> states = cp.states;
+    size_t j = 0;
+    k = 0;
+    for (Map *e = hist->getEpisodes(); e->hasNext(); k++)
+    {
+        EpisodeHistory *eh = (EpisodeHistory *) e->nextValue();
+        if (cp.nsim[k] < 1 || j + cp.nsim[k] > times.size())
+            throw std::runtime_error("Checkpoint is corrupt");
+        ConstrainedSimulator::setEpisodeState(model,eh,cp.nsim[k],&times[j],&states[j]);
+        j += cp.nsim[k];
+    }
+
+    if (!random->setState(cp.rng))
+        throw std::runtime_error("Cannot restore the random number generator from the checkpoint");
+
+    mc->historyChanged();
+}
+
+// Binary file helpers. Values are written in native byte order.
+
+static void put(FILE *f, const void *x, size_t size)
+{
+    if (size > 0 && fwrite(x, size, 1, f) != 1)
+        throw std::runtime_error("Cannot write checkpoint");
+}
+
+template <typename T> static void putVector(FILE *f, const std::vector<T> &x)
+{
+    uint64_t n = x.size();
+    put(f, &n, 8);
+    put(f, x.data(), n * sizeof(T));
+}
+
+static void get(FILE *f, void *x, size_t size)
+{
+    if (size > 0 && fread(x, size, 1, f) != 1)
+        throw std::runtime_error("Checkpoint file is truncated");
+}
+
+template <typename T> static void getVector(FILE *f, std::vector<T> &x)
+{
+    uint64_t n = 0;
+    get(f, &n, 8);
+    if (n > ((uint64_t) 1 << 40) / sizeof(T))
+        throw std::runtime_error("Checkpoint file is corrupt");
+    x.resize(n);
+    get(f, x.data(), n * sizeof(T));
+}
+
+void writeCheckpoint(const std::string &path, const Checkpoint &cp)
+{
+    std::string tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == 0)
+        throw std::runtime_error("Cannot open checkpoint file " + tmp);
+
+    try
+    {
+        uint32_t ncomp = cp.params.size();
+        put(f, magic, 8);
+        put(f, &version, 4);
+        put(f, &ncomp, 4);
+        put(f, &cp.iteration, 8);
+        put(f, &cp.nburn, 8);
+        put(f, &cp.seed, 8);
+        putVector(f, cp.rng);
+        for (uint32_t i=0; i<ncomp; i++)
+            putVector(f, cp.params[i]);
+        putVector(f, cp.admit);
+        putVector(f, cp.nsim);
+        putVector(f, cp.times);
+        putVector(f, cp.states);
+        putVector(f, cp.waic);
+        putVector(f, cp.setup);
+    }
+    catch (...)
+    {
+        fclose(f);
+        remove(tmp.c_str());
+        throw;
+    }
+
+    if (fclose(f) != 0)
+    {
+        remove(tmp.c_str());
+        throw std::runtime_error("Cannot write checkpoint file " + tmp);
+    }
+
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows.
+    remove(path.c_str());
+#endif
+    if (rename(tmp.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("Cannot replace checkpoint file " + path);
+}
+
+void readCheckpoint(const std::string &path, Checkpoint &cp)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == 0)
+        throw std::runtime_error("Cannot open checkpoint file " + path);
+
+    try
+    {
+        char m[8];
+        uint32_t v = 0;
+        uint32_t ncomp = 0;
+        get(f, m, 8);
+        if (memcmp(m, magic, 8) != 0)
+            throw std::runtime_error(path + " is not a checkpoint file");
+        get(f, &v, 4);
+        if (v != version)
+            throw std::runtime_error("Checkpoint file " + path + " has an unknown version");
+        get(f, &ncomp, 4);
+        if (ncomp > 64)
+            throw std::runtime_error("Checkpoint file is corrupt");
+        get(f, &cp.iteration, 8);
+        get(f, &cp.nburn, 8);
+        get(f, &cp.seed, 8);
+        getVector(f, cp.rng);
+        cp.params.resize(ncomp);
+        for (uint32_t i=0; i<ncomp; i++)
+            getVector(f, cp.params[i]);
+        getVector(f, cp.admit);
+        getVector(f, cp.nsim);
+        getVector(f, cp.times);
+        getVector(f, cp.states);
+        getVector(f, cp.waic);
+        getVector(f, cp.setup);
+        if (cp.nsim.size() != cp.admit.size() || cp.times.size() != cp.states.size())
+            throw std::runtime_error("Checkpoint file is corrupt");
+    }
+    catch (...)
+    {
+        fclose(f);
+        throw;
+    }
+    fclose(f);
+}
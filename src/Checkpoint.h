@@ -0,0 +1,71 @@
+#ifndef bayesian_transmission_Checkpoint_h
+#define bayesian_transmission_Checkpoint_h
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "util/util.h"
+#include "infect/infect.h"
+#include "modeling/modeling.h"
+#include "lognormal/lognormal.h"
+
+/*
+    Checkpoints of a running chain.
+
+    A checkpoint holds what the data and model settings don't determine:
+    the sampled state of each episode, the parameter values and the state
+    of the random number generator. A chain is resumed by building the
+    SystemHistory and Sampler from the data as usual and then putting the
+    checkpoint back with setCheckpoint(), with no need for burn-in.
+
+    Nothing here touches the R API, apart from through the Random.
+*/
+
+struct Checkpoint
+{
+    /// Iterations run so far, burn-in included, and the burn-in asked for.
+    uint64_t iteration;
+    uint64_t nburn;
+
+    /// Master seed the chain was started with. Resuming uses the saved
+    /// generator state instead, so this is only kept to report.
+    uint64_t seed;
+
+    /// Random number generator state, see Random::getState().
+    std::vector<uint64_t> rng;
+
+    /// Parameters::getState() of each model component, in the order of
+    /// modelValues().
+    std::vector< std::vector<double> > params;
+
+    /// Episode states, in SystemHistory::getEpisodes() order, as given by
+    /// ConstrainedSimulator::getEpisodeState(): nsim[i] entries of times
+    /// and states for episode i, which was admitted at admit[i].
+    std::vector<double> admit;
+    std::vector<int> nsim;
+    std::vector<double> times;
+    std::vector<int> states;
+
+    /// PointwiseWAIC::getState() of the chain's WAIC accumulators, or empty
+    /// if they were not saved.
+    std::vector<double> waic;
+
+    /// Opaque settings kept for the caller, such as how the model was made.
+    std::vector<unsigned char> setup;
+};
+
+/// Saves the state of a chain.
+void getCheckpoint(infect::SystemHistory *hist, lognormal::LogNormalModel *model, util::Random *random, Checkpoint &cp);
+
+/// Restores the state of a chain whose history and sampler have been made
+/// from the same data and model settings as the checkpointed one.
+void setCheckpoint(const Checkpoint &cp, infect::SystemHistory *hist, infect::Sampler *mc, lognormal::LogNormalModel *model, util::Random *random);
+
+/// Writes a checkpoint to a file. The file is replaced in one step, so a
+/// job stopped while writing leaves the previous checkpoint in place.
+void writeCheckpoint(const std::string &path, const Checkpoint &cp);
+
+void readCheckpoint(const std::string &path, Checkpoint &cp);
+
+#endif // bayesian_transmission_Checkpoint_h
@@ -0,0 +1,316 @@
+#include "MCMCChain.h"
+
+#include <atomic>
+#include <limits>
+#include <thread>
+
+using namespace util;
+using namespace infect;
+using namespace lognormal;
+
+std::vector< std::vector<double> > modelValues(const LogNormalModel *model)
+{
+    std::vector< std::vector<double> > x;
+    x.push_back(model->getInsituParams()->getValues());
+    x.push_back(model->getSurveillanceTestParams()->getValues());
+    x.push_back(model->getClinicalTestParams()->getValues());
+    x.push_back(model->getOutColParams()->getValues());
+    x.push_back(model->getInColParams()->getValues());
+    x.push_back(model->getAbxParams()->getValues());
+    return x;
+}
+
+Parameters *modelComponent(const LogNormalModel *model, int i)
+{
+    switch(i)
+    {
+    case 0: return model->getInsituParams();
+    case 1: return model->getSurveillanceTestParams();
+    case 2: return model->getClinicalTestParams();
+    case 3: return model->getOutColParams();
+    case 4: return model->getInColParams();
+    default: return model->getAbxParams();
+    }
+}
+
+void setModelValues(LogNormalModel *model, const std::vector< std::vector<double> > &values)
+{
+    if (values.size() != (size_t) nModelComponents)
+        throw std::runtime_error("Wrong number of model components");
+    for (int i=0; i<nModelComponents; i++)
+        modelComponent(model,i)->setValues(values[i]);
+}
+
+std::vector<std::string> traceNames(const LogNormalModel *model)
+{
+    std::vector<std::string> names;
+    for (int i=0; i<nModelComponents; i++)
+    {
+        std::vector<std::string> x = modelComponent(model,i)->paramNames();
+        if (x.size() != modelComponent(model,i)->getValues().size())
+            throw std::logic_error("Parameter names do not match values for " + modelComponent(model,i)->className());
+        names.insert(names.end(), x.begin(), x.end());
+    }
+    names.push_back("LogLikelihood");
+    return names;
+}
+
+void traceRow(const LogNormalModel *model, double loglik, std::vector<double> &row)
+{
+    row.clear();
+    for (int i=0; i<nModelComponents; i++)
+    {
+        std::vector<double> x = modelComponent(model,i)->getValues();
+        row.insert(row.end(), x.begin(), x.end());
+    }
+    row.push_back(loglik);
+}
+
+void profileRows(const Profile &p, const LogNormalModel *model, std::vector<ProfileRow> &rows)
+{
+    double na = std::numeric_limits<double>::quiet_NaN();
+
+    rows.clear();
+    for (int i=0; i<Profile::ntimers; i++)
+        rows.push_back(ProfileRow{Profile::timerName(i), (double) p.getCalls(i), p.getSeconds(i), na});
+
+    rows.push_back(ProfileRow{Profile::counterName(Profile::ExpQt), (double) p.getCount(Profile::ExpQt), na, na});
+    rows.push_back(ProfileRow{Profile::counterName(Profile::ExpQtMemo), (double) p.getCount(Profile::ExpQtMemo), na, na});
+    rows.push_back(ProfileRow{Profile::counterName(Profile::EpisodeProposals), (double) p.getCount(Profile::EpisodeProposals), na, (double) p.getCount(Profile::EpisodeAccepts)});
+
+    LogNormalICP *icp = (LogNormalICP *) model->getInColParams();
+    std::vector<std::string> names = icp->paramNames();
+    std::vector<int> proposed;
+    std::vector<int> accepted;
+    icp->getAcceptance(proposed, accepted);
+    for (unsigned int i=0; i<names.size() && i<proposed.size(); i++)
+        if (proposed[i] > 0)
+            rows.push_back(ProfileRow{names[i], (double) proposed[i], na, (double) accepted[i]});
+}
+
+unsigned int chainBurnin(const ChainCheckpoint *cc, unsigned int nburn)
+{
+    return cc != 0 && cc->from != 0 ? cc->from->nburn : nburn;
+}
+
+unsigned int chainBurninLeft(const ChainCheckpoint *cc, unsigned int nburn)
+{
+    uint64_t start = chainStart(cc);
+    nburn = chainBurnin(cc,nburn);
+    return start < nburn ? nburn - start : 0;
+}
+
+uint64_t chainStart(const ChainCheckpoint *cc)
+{
+    return cc != 0 && cc->from != 0 ? cc->from->iteration : 0;
+}
+
+void resumeChain(const ChainCheckpoint *cc, SystemHistory *hist, Sampler *mc, LogNormalModel *model, Random *random)
+{
+    if (cc != 0 && cc->from != 0)
+        setCheckpoint(*cc->from, hist, mc, model, random);
+}
+
+void resumeWAIC(const ChainCheckpoint *cc, PointwiseWAIC &waic)
+{
+    if (cc != 0 && cc->from != 0 && !cc->from->waic.empty())
+        waic.setState(cc->from->waic);
+}
+
+void checkpointChain(const ChainCheckpoint *cc, uint64_t done, unsigned int nburn, bool last, SystemHistory *hist, LogNormalModel *model, Random *random, TraceWriter *trace, const PointwiseWAIC *waic)
+{
+    if (cc == 0 || cc->path.empty())
+        return;
+
+    // The last call comes after the call for the same iteration, so only
+    // write then if that didn't.
+    uint64_t n = done - chainStart(cc);
+    bool due = cc->every > 0 && n > 0 && n % cc->every == 0;
+    if (last == due)
+        return;
+
+    if (trace != 0)
+        trace->flush();
+
+    Checkpoint cp;
+    cp.iteration = done;
+    cp.nburn = nburn;
+    cp.setup = cc->setup;
+    cp.seed = cc->seed;
+    getCheckpoint(hist, model, random, cp);
+    if (waic != 0)
+        waic->getState(cp.waic);
+    writeCheckpoint(cc->path, cp);
+}
+
+void runChain(
+    const ChainData &data,
+    LogNormalModel *model,
+    Random *random,
+    unsigned int nsims,
+    unsigned int nburn,
+    bool outputparam,
+    bool outputfinal,
+    ChainResult &res,
+    TraceWriter *trace,
+    const ChainCheckpoint *cc,
+    bool profile,
+    unsigned int loothin
+)
+{
+    // The system abx maps are per thread, but a pool thread may run
+    // several chains so clear out anything left by the last one.
+    AbxCoding::sysabx->clear();
+    AbxCoding::syseverabx->clear();
+
+    System *sys = new System(data.facilities, data.units, data.times, data.patients, data.types);
+
+    LogNormalICP *icp = (LogNormalICP *) model->getInColParams();
+    icp->setTimeOrigin((sys->endTime()-sys->startTime())/2.0);
+
+    SystemHistory *hist = new SystemHistory(sys, model, false);
+
+    // Find tests for posterior prediction and, hence, WAIC estimates.
+
+    WAICTests tests(hist, model);
+    res.waic = PointwiseWAIC(tests.size(), loothin);
+    res.testtime.clear();
+    res.testpatient.clear();
+    for (unsigned int j=0; j<tests.size(); j++)
+    {
+        res.testtime.push_back(tests.time(j));
+        res.testpatient.push_back(tests.patient(j));
+    }
+
+    Sampler *mc = new Sampler(hist,model,random);
+    resumeChain(cc, hist, mc, model, random);
+    resumeWAIC(cc, res.waic);
+
+    uint64_t done = chainStart(cc);
+    unsigned int burn = chainBurninLeft(cc, nburn);
+    nburn = chainBurnin(cc, nburn);
+
+    Profile prof;
+    Profile::Use use(profile ? &prof : 0);
+    if (profile)
+        ((LogNormalICP *) model->getInColParams())->clearAcceptance();
+
+    model->setAdapting(true);
+    for (unsigned int i=0; i<burn; i++)
+    {
+        mc->sampleEpisodes();
+        mc->sampleModel();
+        checkpointChain(cc, ++done, nburn, false, hist, model, random, trace, &res.waic);
+    }
+    model->setAdapting(false);
+
+    if (outputparam)
+    {
+        if (trace == 0)
+            res.params.reserve(nsims);
+        res.loglik.reserve(nsims);
+    }
+    std::vector<double> row;
+
+    for (unsigned int i=0; i<nsims; i++)
+    {
+        mc->sampleEpisodes();
+        mc->sampleModel();
+
+        if (outputparam)
+        {
+            double ll = mc->logLikelihood();
+            if (trace != 0)
+            {
+                traceRow(model, ll, row);
+                trace->write(&row[0]);
+            }
+            else
+            {
+                res.params.push_back(modelValues(model));
+            }
+            res.loglik.push_back(ll);
+        }
+
+        tests.sample(res.waic, model->getUnitThreads());
+
+        checkpointChain(cc, ++done, nburn, false, hist, model, random, trace, &res.waic);
+    }
+
+    if (outputfinal)
+        res.final = modelValues(model);
+    if (profile)
+        profileRows(prof, model, res.profile);
+
+    if (trace != 0)
+        trace->close();
+
+    checkpointChain(cc, done, nburn, true, hist, model, random, trace, &res.waic);
+
+    delete mc;
+    delete hist;
+    delete sys;
+
+    AbxCoding::sysabx->clear();
+    AbxCoding::syseverabx->clear();
+}
+
+void runChains(
+    const ChainData &data,
+    std::vector<LogNormalModel *> &models,
+    uint64_t seed,
+    unsigned int nthreads,
+    unsigned int nsims,
+    unsigned int nburn,
+    bool outputparam,
+    bool outputfinal,
+    std::vector<ChainResult> &res,
+    const std::vector<std::string> &tracefiles,
+    const std::vector<ChainCheckpoint> &checkpoints,
+    bool profile,
+    unsigned int loothin
+)
+{
+    unsigned int nchains = models.size();
+    res.assign(nchains, ChainResult());
+
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > nchains)
+        nthreads = nchains;
+
+    // Chains are handed out to the pool threads in order.
+    std::atomic<unsigned int> nextchain(0);
+
+    auto worker = [&]()
+    {
+        for (unsigned int i = nextchain++; i < nchains; i = nextchain++)
+        {
+            try
+            {
+                XoshiroRandom random(seed, i);
+                const ChainCheckpoint *cc = checkpoints.empty() ? 0 : &checkpoints[i];
+                if (tracefiles.empty())
+                {
+                    runChain(data, models[i], &random, nsims, nburn, outputparam, outputfinal, res[i], 0, cc, profile, loothin);
+                }
+                else
+                {
+                    TraceWriter trace(tracefiles[i], traceNames(models[i]), outputparam ? nsims : 0);
+                    runChain(data, models[i], &random, nsims, nburn, outputparam, outputfinal, res[i], &trace, cc, profile, loothin);
+                }
+            }
+            catch (std::exception &e)
+            {
+                res[i].error = e.what();
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned int t=1; t<nthreads; t++)
+        pool.push_back(std::thread(worker));
+    worker();
+    for (unsigned int t=0; t<pool.size(); t++)
+        pool[t].join();
+}
@@ -0,0 +1,168 @@
+#ifndef bayesian_transmission_MCMCChain_h
+#define bayesian_transmission_MCMCChain_h
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "util/util.h"
+#include "infect/infect.h"
+#include "modeling/modeling.h"
+#include "lognormal/lognormal.h"
+#include "TraceFile.h"
+#include "Checkpoint.h"
+#include "WAIC.h"
+
+/*
+    Plain C++ driver for MCMC chains.
+
+    Nothing here touches the R API, so chains can be run off the main R
+    thread. Each chain builds its own System and SystemHistory from the
+    raw event vectors, and results are kept as plain values for runMCMC
+    to convert to R objects once the chains have finished.
+*/
+
+/// Raw event data, as the five columns of the input data frame.
+struct ChainData
+{
+    std::vector<int> facilities;
+    std::vector<int> units;
+    std::vector<double> times;
+    std::vector<int> patients;
+    std::vector<int> types;
+};
+
+/// One row of a sampler profile: a timer, a counter, or the
+/// Metropolis-Hastings proposals for one in unit parameter. Entries that
+/// do not apply are NaN.
+struct ProfileRow
+{
+    std::string name;
+    double calls;
+    double seconds;
+    double accepted;
+};
+
+/// The rows for profile p of a chain of model, with the proposals made
+/// and accepted for each in unit parameter that is updated.
+void profileRows(const util::Profile &p, const lognormal::LogNormalModel *model, std::vector<ProfileRow> &rows);
+
+/// Output of one chain.
+struct ChainResult
+{
+    /// Parameter values at each iteration, one vector per model component
+    /// in the order returned by modelValues().
+    std::vector< std::vector< std::vector<double> > > params;
+    std::vector<double> loglik;
+    std::vector< std::vector<double> > final;
+    /// Pointwise WAIC accumulators over the tests, with the time and
+    /// patient of each test.
+    PointwiseWAIC waic;
+    std::vector<double> testtime;
+    std::vector<int> testpatient;
+    std::vector<ProfileRow> profile;
+    std::string error;
+};
+
+/// Checkpointing of one chain.
+struct ChainCheckpoint
+{
+    /// File to write checkpoints to, or empty for none.
+    std::string path;
+    /// Iterations between checkpoints. With zero one is only written at
+    /// the end.
+    unsigned int every;
+    /// Checkpoint to resume from, or null to start a new chain.
+    const Checkpoint *from;
+    /// Copied to Checkpoint::setup and Checkpoint::seed in the
+    /// checkpoints written.
+    std::vector<unsigned char> setup;
+    uint64_t seed;
+
+    ChainCheckpoint() : every(0), from(0), seed(0) {}
+};
+
+/// Total burn-in of the chain, and how much of it is still to run. A
+/// resumed chain keeps the burn-in it was started with.
+unsigned int chainBurnin(const ChainCheckpoint *cc, unsigned int nburn);
+unsigned int chainBurninLeft(const ChainCheckpoint *cc, unsigned int nburn);
+
+/// Iterations already run, burn-in included, before this run started.
+uint64_t chainStart(const ChainCheckpoint *cc);
+
+/// Puts back the checkpoint, if any, that a newly made chain resumes from.
+void resumeChain(const ChainCheckpoint *cc, infect::SystemHistory *hist, infect::Sampler *mc, lognormal::LogNormalModel *model, util::Random *random);
+
+/// Called after each iteration, with done counting from the start of the
+/// chain, and again with last set at the end. Writes a checkpoint every
+/// cc->every iterations and at the end, first flushing the trace, if
+/// given, so that it has every iteration up to the checkpoint. The WAIC
+/// accumulators, if given, are saved with the chain.
+void checkpointChain(const ChainCheckpoint *cc, uint64_t done, unsigned int nburn, bool last, infect::SystemHistory *hist, lognormal::LogNormalModel *model, util::Random *random, TraceWriter *trace = 0, const PointwiseWAIC *waic = 0);
+
+/// Puts back the WAIC accumulators, if any, saved in the checkpoint a
+/// chain resumes from.
+void resumeWAIC(const ChainCheckpoint *cc, PointwiseWAIC &waic);
+
+/// Values of the model parameters in the same component order as model2R():
+/// Insitu, SurveillanceTest, ClinicalTest, OutCol, InCol, Abx.
+std::vector< std::vector<double> > modelValues(const lognormal::LogNormalModel *model);
+
+/// Model component i in the order of modelValues().
+const int nModelComponents = 6;
+models::Parameters *modelComponent(const lognormal::LogNormalModel *model, int i);
+
+/// Sets the model parameters to values saved by modelValues().
+void setModelValues(lognormal::LogNormalModel *model, const std::vector< std::vector<double> > &values);
+
+/// Column names for a trace file: the paramNames() of each component in
+/// the order of modelValues(), then "LogLikelihood".
+std::vector<std::string> traceNames(const lognormal::LogNormalModel *model);
+
+/// The current model values and the log likelihood as a trace file row.
+void traceRow(const lognormal::LogNormalModel *model, double loglik, std::vector<double> &row);
+
+/// Run one chain to completion on the calling thread.
+/// If trace is given the parameter values are written to it rather than
+/// kept in res.params. If cc is given the chain is checkpointed and, if
+/// cc->from is set, resumed, in which case nburn is taken from there.
+/// If profile is set the sampler is profiled, burn-in included, into
+/// res.profile. The tests' log probabilities are added to res.waic after
+/// each iteration past burn-in, and those of every loothin-th iteration
+/// are kept if loothin is not zero.
+void runChain(
+    const ChainData &data,
+    lognormal::LogNormalModel *model,
+    util::Random *random,
+    unsigned int nsims,
+    unsigned int nburn,
+    bool outputparam,
+    bool outputfinal,
+    ChainResult &res,
+    TraceWriter *trace = 0,
+    const ChainCheckpoint *cc = 0,
+    bool profile = false,
+    unsigned int loothin = 0
+);
+
+/// Run one chain per model on a pool of nthreads threads.
+/// Chain i uses stream i of a XoshiroRandom seeded with seed. If tracefiles
+/// is not empty chain i writes its trace to tracefiles[i], and likewise for
+/// checkpoints.
+void runChains(
+    const ChainData &data,
+    std::vector<lognormal::LogNormalModel *> &models,
+    uint64_t seed,
+    unsigned int nthreads,
+    unsigned int nsims,
+    unsigned int nburn,
+    bool outputparam,
+    bool outputfinal,
+    std::vector<ChainResult> &res,
+    const std::vector<std::string> &tracefiles = std::vector<std::string>(),
+    const std::vector<ChainCheckpoint> &checkpoints = std::vector<ChainCheckpoint>(),
+    bool profile = false,
+    unsigned int loothin = 0
+);
+
+#endif // bayesian_transmission_MCMCChain_h
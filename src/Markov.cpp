@@ -1,4 +1,5 @@
 #include "util/Markov.h"
+#include "util/Profile.h"
 
 #include <stdio.h>
 #include <iostream>
@@ -6,6 +7,10 @@
 #include <math.h>
 #include <stdexcept>
 #include <vector>
+#include <complex>
+#include <string.h>
+#include <stdint.h>
+#include <new>
 using namespace std;
 
 #include <RcppArmadillo.h>
@@ -14,39 +19,183 @@ using namespace arma;
 
 namespace util{
 
-void Markov::expQt(int n, double **Q, double t, double **etQ)
+// Closed form exp(Qt) for a two state generator Q = [[-a,a],[b,-b]].
+void Markov::expQt2(double **Q, double t, double **etQ)
+{
+	double a = Q[0][1];
+	double b = Q[1][0];
+	double s = a + b;
+
+	// f = (1-exp(-st))/s, taken as t when s is zero.
+	double f = s > 0 ? -expm1(-s*t)/s : t;
+
+	etQ[0][1] = a*f;
+	etQ[0][0] = 1 - etQ[0][1];
+	etQ[1][0] = b*f;
+	etQ[1][1] = 1 - etQ[1][0];
+}
+
+// Closed form exp(Qt) for a three state generator, such as the cyclic
+// acquisition, progression, clearance matrix. Q has eigenvalues 0, l2, l3,
+// where l2 and l3 solve x^2 + l x + m = 0, and by Putzer's method
+// 	exp(Qt) = I + r2 Q + r3 Q (Q - l2 I).
+// Returns false, leaving etQ unset, if l2 and l3 are too close to each
+// other or to 0 for this to be accurate.
+bool Markov::expQt3(double **Q, double t, double **etQ)
 {
-	arma::mat M(n,n);
-	for (int i=0; i<n; i++)
-		for (int j=0; j<n; j++)
-			M(i,j) = Q[i][j];
-	M *= t;
+	double l = -(Q[0][0] + Q[1][1] + Q[2][2]);
+	double m = Q[0][0]*Q[1][1] - Q[0][1]*Q[1][0]
+		+ Q[1][1]*Q[2][2] - Q[1][2]*Q[2][1]
+		+ Q[0][0]*Q[2][2] - Q[0][2]*Q[2][0];
+	double d = l*l - 4*m;
+
+	double tol = 0.000001 * l * l;
+	if (!(l > 0) || m < tol || fabs(d) < tol)
+		return false;
+
+	complex<double> rd = sqrt(complex<double>(d));
+	complex<double> l2 = (-l + rd)/2.0;
+	complex<double> l3 = (-l - rd)/2.0;
+
+	complex<double> e2 = (exp(l2*t) - 1.0)/l2;
+	complex<double> e3 = (exp(l3*t) - 1.0)/l3;
+
+	double r2 = real(e2);
+	double r3 = real((e2 - e3)/(l2 - l3));
+	double a1 = r2 - real(l2*(e2 - e3)/(l2 - l3));
+
+	for (int i=0; i<3; i++)
+		for (int j=0; j<3; j++)
+		{
+			double qq = 0;
+			for (int k=0; k<3; k++)
+				qq += Q[i][k]*Q[k][j];
+			etQ[i][j] = (i == j ? 1 : 0) + a1*Q[i][j] + r3*qq;
+		}
+
+	return true;
+}
 
-	M = arma::expmat(M);
+// Per thread memo of recent exp(Qt) results for three or more states,
+// keyed on the values of Q and t. Patients in the same unit at the same
+// time often give identical intervals.
+namespace {
+	struct ExpQtMemo
+	{
+		static const int size = 1024;
+		static const int maxstates = 3;
+
+		int ns[size];
+		double key[size][maxstates*maxstates+1];
+		double val[size][maxstates*maxstates];
+
+		ExpQtMemo()
+		{
+			for (int i=0; i<size; i++)
+				ns[i] = 0;
+		}
+
+		inline int slot(int n, double **Q, double t, double *k) const
+		{
+			uint64_t h = 14695981039346656037ULL;
+			int c = 0;
+			for (int i=0; i<n; i++)
+				for (int j=0; j<n; j++)
+					k[c++] = Q[i][j];
+			k[c++] = t;
+			for (int i=0; i<c; i++)
+			{
+				uint64_t b = 0;
+				memcpy(&b,&k[i],sizeof(double));
+				h = (h ^ b) * 1099511628211ULL;
+			}
+			return (int) ((h ^ (h >> 32)) % size);
+		}
+	};
+
+	thread_local ExpQtMemo expqtmemo;
+}
 
-	for (int i=0; i<n; i++)
-		for (int j=0; j<n; j++)
-			etQ[i][j] = M(i,j);
+void Markov::expQt(int n, double **Q, double t, double **etQ)
+{
+	Profile::count(Profile::ExpQt);
+
+	if (n == 2)
+	{
+		expQt2(Q,t,etQ);
+		return;
+	}
+
+	ExpQtMemo &memo = expqtmemo;
+	double k[ExpQtMemo::maxstates*ExpQtMemo::maxstates+1];
+	int h = -1;
+
+	if (n <= ExpQtMemo::maxstates)
+	{
+		h = memo.slot(n,Q,t,k);
+		if (memo.ns[h] == n && memcmp(memo.key[h],k,(n*n+1)*sizeof(double)) == 0)
+		{
+			Profile::count(Profile::ExpQtMemo);
+			for (int i=0, c=0; i<n; i++)
+				for (int j=0; j<n; j++)
+					etQ[i][j] = memo.val[h][c++];
+			return;
+		}
+	}
+
+	if (n != 3 || !expQt3(Q,t,etQ))
+	{
+		arma::mat M(n,n);
+		for (int i=0; i<n; i++)
+			for (int j=0; j<n; j++)
+				M(i,j) = Q[i][j];
+		M *= t;
+
+		M = arma::expmat(M);
+
+		for (int i=0; i<n; i++)
+			for (int j=0; j<n; j++)
+				etQ[i][j] = M(i,j);
+	}
+
+	if (h >= 0)
+	{
+		memo.ns[h] = n;
+		memcpy(memo.key[h],k,(n*n+1)*sizeof(double));
+		for (int i=0, c=0; i<n; i++)
+			for (int j=0; j<n; j++)
+				memo.val[h][c++] = etQ[i][j];
+	}
 }
 
 
-Markov::Markov (int nstates, int npoints, double *t, double ***Q, double **S, bool *d, Random *r)
+// Reused paths, so that sampling does not allocate once they have grown.
+static thread_local vector<timepoint> markovpath;
+
+Markov::Markov (int nstates, int npoints, double *t, double ***Q, double **S, bool *d, Random *r, Arena *a)
 {
+    Profile::Scope timer(Profile::MarkovSetup);
+
     rand = r;
+    arena = a;
     n = npoints;
     ns = nstates;
 
-    x = new checkpoint*[n];
+    checkpoint *cp = arena->alloc<checkpoint>(n);
+    x = arena->alloc<checkpoint *>(n);
+    S0 = arena->alloc<double *>(n);
     for (int i=0; i<n; i++)
-        x[i] = new checkpoint(i,0,0,0,0,true);
-    for (int i=0; i<n-1; i++)
-        x[i]->alloc(ns);
-
+    {
+        x[i] = new (&cp[i]) checkpoint(i,0,0,0,0,true);
+        if (i < n-1)
+            x[i]->alloc(ns,arena);
+    }
 
     for (int i=0; i<n; i++)
     {
         x[i]->time = t[i];
         x[i]->S = S[i];
+        S0[i] = S[i];
         x[i]->Q = Q[i];
         x[i]->doit = d[i];
     }
@@ -58,39 +207,20 @@ Markov::Markov (int nstates, int npoints, double *t, double ***Q, double **S, bo
         if (x[i]->Q)
             q = x[i]->Q;
 
-        x[i]->P = new double*[ns];
-        for (int j=0; j<ns; j++)
-            x[i]->P[j] = new double[ns];
+        x[i]->P = arena->cleanAlloc(ns,ns);
         expQt(ns,q,x[i+1]->time - x[i]->time,x[i]->P);
     }
 
     collect();
 }
 
-Markov::~Markov()
+void Markov::simulateProcess(double **Q, checkpoint *y, checkpoint *z, vector<timepoint> &v) const
 {
-    for (int i=0; i<n; i++)
-        if (x[i]->P)
-        {
-            for (int j=0; j<ns; j++)
-                delete [] x[i]->P[j];
-            delete [] x[i]->P;
-        }
-
-    for (int i=0; i<n-1; i++)
-        x[i]->dealloc(ns);
-    for (int i=0; i<n; i++)
-        delete x[i];
-    delete [] x;
-}
-
-vector<timepoint> Markov::simulateProcess(double **Q, checkpoint *y, checkpoint *z) const
-{
-    vector<timepoint> v;
+    size_t start = v.size();
 
     for (int s = -1; s != z->state; )
     {
-        v.clear();
+        v.resize(start,timepoint(0,0,false));
         double t = 0;
 
         for (t = y->time, s = y->state; (t += rand->rexp(-Q[s][s])) <= z->time; )
@@ -99,13 +229,11 @@ vector<timepoint> Markov::simulateProcess(double **Q, checkpoint *y, checkpoint
             v.push_back(timepoint(t,s,false));
         }
     }
-
-    return v;
 }
 
-vector<timepoint> Markov::simulateProcess()
+void Markov::simulateProcess(vector<timepoint> &v)
 {
-    vector<timepoint> v;
+    v.clear();
 
     double **Q = x[0]->Q;
     append(&v,x[0]);
@@ -114,22 +242,21 @@ vector<timepoint> Markov::simulateProcess()
     {
         if (x[i-1]->doit)
         {
-            append(&v,simulateProcess(Q,x[i-1],x[i]));
+            simulateProcess(Q,x[i-1],x[i],v);
         }
         else
             append(&v,x[i]);
         if (x[i]->Q)
             Q = x[i]->Q;
     }
-
-    return v;
 }
 
 double Markov::simulateProcess(int segs, int *ec, double **et, int **es)
 {
     simulateChain();
 
-    vector<timepoint> vv = simulateProcess();
+    vector<timepoint> &vv = markovpath;
+    simulateProcess(vv);
 
     for (int c=0, l=0, i=0, k=0; l<n; c++, l=k+1)
     {
@@ -137,19 +264,18 @@ double Markov::simulateProcess(int segs, int *ec, double **et, int **es)
             if (!x[k]->doit)
                 break;
 
-        vector<timepoint> v;
-        v.push_back(vv[i++]);
-        while (i < (int) vv.size() && !vv[i].restart)
-            v.push_back(vv[i++]);
+        int m = 1;
+        while (i+m < (int) vv.size() && !vv[i+m].restart)
+            m++;
 
-        ec[c] = (int) v.size();
-        et[c] = new double[ec[c]];
-        es[c] = new int[ec[c]];
+        ec[c] = m;
+        et[c] = arena->alloc<double>(m);
+        es[c] = arena->alloc<int>(m);
 
-        for (int j=0; j<ec[c]; j++)
+        for (int j=0; j<m; j++, i++)
         {
-            et[c][j] = v[j].time;
-            es[c][j] = v[j].state;
+            et[c][j] = vv[i].time;
+            es[c][j] = vv[i].state;
         }
     }
 
@@ -158,7 +284,8 @@ double Markov::simulateProcess(int segs, int *ec, double **et, int **es)
 
 double Markov::logProcessProb(int segs, int *ec, double **et, int **es) const
 {
-    vector<timepoint> v;
+    vector<timepoint> &v = markovpath;
+    v.clear();
 
     for (int i=0; i<segs; i++)
     {
@@ -179,7 +306,7 @@ double Markov::logChainProb()
     return l;
 }
 
-double Markov::logProb(vector<timepoint> v) const
+double Markov::logProb(const vector<timepoint> &v) const
 {
     double l = -logtot;
 
@@ -263,6 +390,28 @@ void Markov::collect()
     }
 }
 
+void Markov::fix(int i, int s)
+{
+    if (i < 0 || i >= n)
+        return;
+
+    double *y = arena->alloc<double>(ns);
+    for (int j=0; j<ns; j++)
+        y[j] = j != s ? 0 : S0[i] != 0 ? S0[i][j] : 1;
+    x[i]->S = y;
+}
+
+void Markov::condition(int a, int sa, int b, int sb)
+{
+    for (int i=0; i<n; i++)
+        x[i]->S = S0[i];
+
+    fix(a,sa);
+    fix(b,sb);
+
+    collect();
+}
+
 void Markov::simulateChain()
 {
     x[0]->state = rand->rint(ns,x[0]->R);
@@ -178,6 +178,7 @@ void init_Module_infect_system(){
         .constructor<SystemHistory*, Model*, Random*>()
         .method<void>("sampleModel", &infect::Sampler::sampleModel)
         .method<void>("sampleEpisodes", &infect::Sampler::sampleEpisodes)
+        .method("logLikelihood", &infect::Sampler::logLikelihood)
     ;
     
     class_<System>("CppSystem")
@@ -188,7 +188,7 @@ void init_Module_infect(){
         // .property("nPatients", &infect::Model::getNPatients)
         // .property("nFacilities", &infect::Model::getNFacilities)
 
-        .method("logLikelihood", &infect::Model::logLikelihood)
+        .method("logLikelihood", static_cast<double (infect::Model::*)(infect::SystemHistory*)>(&infect::Model::logLikelihood))
         .method("logLikelihoodLink", &Model_logLikelihoodLink_wrapper)
         .method("update", &infect::Model::update)
         .method("forwardSimulate", &infect::Model::forwardSimulate)
@@ -60,6 +60,7 @@ void init_Module_lognormal(){
         .property("names", &lognormal::LogNormalICP::paramNames)
         .property("values", &lognormal::LogNormalICP::getValues)
         .property("timeOrigin", &lognormal::LogNormalICP::getTimeOrigin, &lognormal::LogNormalICP::setTimeOrigin)
+        .method("gradient", &lognormal::LogNormalICP::getGradient)
     ;
 
     class_<lognormal::LogNormalAbxICP>("CppLogNormalAbxICP")
@@ -0,0 +1,235 @@
+#include "Predictive.h"
+
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+using namespace util;
+using namespace infect;
+using namespace lognormal;
+
+namespace {
+
+typedef std::map< std::pair<int,int>, int > UnitIndex;
+
+// Adds the tests and acquisitions of hist, with the event types as they
+// are now, to the counts asked for in c.
+void countHistory(SystemHistory *hist, const UnitIndex &index, double start, double binwidth, unsigned int nbins, bool positivity, bool acquisitions, PredictiveCounts &c)
+{
+    size_t m = index.size() * (size_t) nbins;
+    if (positivity)
+    {
+        c.tests.assign(m, 0);
+        c.positives.assign(m, 0);
+    }
+    if (acquisitions)
+        c.acquisitions.assign(m, 0);
+
+    for (HistoryLink *l = hist->getSystemHead(); l != 0; l = l->sNext())
+    {
+        Event *e = l->getEvent();
+        if (e->getUnit() == 0 || e->getFacility() == 0)
+            continue;
+
+        int pos = 0;
+        int neg = 0;
+        int acq = 0;
+        switch(e->getType())
+        {
+        case EventCoding::possurvtest:
+        case EventCoding::posclintest:
+        case EventCoding::postest:
+            pos = 1;
+            break;
+
+        case EventCoding::negsurvtest:
+        case EventCoding::negclintest:
+        case EventCoding::negtest:
+            neg = 1;
+            break;
+
+        case EventCoding::acquisition:
+            acq = 1;
+            break;
+
+        default:
+            continue;
+        }
+
+        UnitIndex::const_iterator u = index.find(std::make_pair(e->getFacility()->getId(), e->getUnit()->getId()));
+        if (u == index.end())
+            continue;
+
+        double b = floor((e->getTime() - start) / binwidth);
+        unsigned int bin = b < 0 ? 0 : (b >= nbins ? nbins-1 : (unsigned int) b);
+        size_t i = (size_t) u->second * nbins + bin;
+
+        if (positivity)
+        {
+            c.tests[i] += pos + neg;
+            c.positives[i] += pos;
+        }
+        if (acquisitions)
+            c.acquisitions[i] += acq;
+    }
+}
+
+// Takes the simulated events out of hist and puts back the observed event
+// types, leaving hist as it was built. Each episode's links are unapplied,
+// which undoes their effect on the states, then dropped.
+void resetHistory(SystemHistory *hist, const std::vector<Event *> &events, const std::vector<EventCoding::EventCode> &types)
+{
+    for (Map *e = hist->getEpisodes(); e->hasNext(); )
+    {
+        EpisodeHistory *eh = (EpisodeHistory *) e->nextValue();
+        eh->unapply();
+        eh->installProposal();
+        eh->clearProposal();
+    }
+
+    for (size_t i=0; i<events.size(); i++)
+        events[i]->setType(types[i]);
+}
+
+} // namespace
+
+void simulatePredictive(
+    const ChainData &data,
+    std::vector<LogNormalModel *> &models,
+    const std::vector< std::vector< std::vector<double> > > &draws,
+    const PredictiveOptions &opt,
+    uint64_t seed,
+    PredictiveResult &res
+)
+{
+    if (models.empty())
+        throw std::invalid_argument("No models to simulate from");
+    if (!(opt.binwidth > 0))
+        throw std::invalid_argument("Bin width must be positive");
+    if (data.times.empty())
+        throw std::invalid_argument("No events to simulate");
+    if (draws.empty() || opt.nreps < 1)
+        throw std::invalid_argument("No draws to simulate from");
+
+    // Units, in order of facility then unit, and time bins from the data.
+
+    UnitIndex index;
+    for (size_t i=0; i<data.units.size(); i++)
+        index[std::make_pair(data.facilities[i], data.units[i])] = 0;
+
+    res.facilities.clear();
+    res.units.clear();
+    for (UnitIndex::iterator u = index.begin(); u != index.end(); u++)
+    {
+        u->second = res.units.size();
+        res.facilities.push_back(u->first.first);
+        res.units.push_back(u->first.second);
+    }
+
+    double start = data.times[0];
+    double end = data.times[0];
+    for (size_t i=1; i<data.times.size(); i++)
+    {
+        if (data.times[i] < start)
+            start = data.times[i];
+        if (data.times[i] > end)
+            end = data.times[i];
+    }
+    res.start = start;
+    res.nbins = (unsigned int) floor((end - start) / opt.binwidth) + 1;
+
+    unsigned int nsims = draws.size() * opt.nreps;
+    res.observed = PredictiveCounts();
+    res.sims.assign(nsims, PredictiveCounts());
+
+    // Simulations are handed out in order. Thread t uses model t, and its
+    // own System and SystemHistory, which are only built if the thread gets
+    // a simulation and are then reset between simulations. If a simulation
+    // fails they are dropped, so the event types it overwrote don't matter.
+
+    std::atomic<unsigned int> nextsim(0);
+    std::exception_ptr error = 0;
+    std::mutex errorlock;
+
+    auto worker = [&](unsigned int t)
+    {
+        LogNormalModel *model = models[t];
+        std::unique_ptr<System> sys;
+        std::unique_ptr<SystemHistory> hist;
+
+        // The observed types, to put back once a simulation has overwritten
+        // them.
+        std::vector<Event *> events;
+        std::vector<EventCoding::EventCode> types;
+
+        try
+        {
+            for (unsigned int k = nextsim++; k < nsims; k = nextsim++)
+            {
+                if (!hist)
+                {
+                    AbxCoding::sysabx->clear();
+                    AbxCoding::syseverabx->clear();
+
+                    model->setForwardEnabled(1);
+                    sys.reset(new System(data.facilities, data.units, data.times, data.patients, data.types));
+                    LogNormalICP *icp = (LogNormalICP *) model->getInColParams();
+                    icp->setTimeOrigin((sys->endTime()-sys->startTime())/2.0);
+
+                    hist.reset(new SystemHistory(sys.get(), model, false));
+                    for (HistoryLink *l = hist->getSystemHead(); l != 0; l = l->sNext())
+                    {
+                        events.push_back(l->getEvent());
+                        types.push_back(l->getEvent()->getType());
+                    }
+                }
+                else
+                {
+                    resetHistory(hist.get(), events, types);
+                }
+
+                setModelValues(model, draws[k / opt.nreps]);
+
+                if (k == 0 && opt.positivity)
+                    countHistory(hist.get(), index, start, opt.binwidth, res.nbins, true, false, res.observed);
+
+                XoshiroRandom random(XoshiroRandom::streamSeed(seed, k));
+                model->forwardSimulate(hist.get(), &random);
+                countHistory(hist.get(), index, start, opt.binwidth, res.nbins, opt.positivity, opt.acquisitions, res.sims[k]);
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(errorlock);
+            if (!error)
+                error = std::current_exception();
+            nextsim = nsims;
+        }
+
+        hist.reset();
+        sys.reset();
+
+        AbxCoding::sysabx->clear();
+        AbxCoding::syseverabx->clear();
+    };
+
+    unsigned int nt = models.size();
+    if (nt > nsims)
+        nt = nsims;
+
+    std::vector<std::thread> pool;
+    for (unsigned int t=1; t<nt; t++)
+        pool.push_back(std::thread(worker, t));
+    worker(0);
+    for (unsigned int t=0; t<pool.size(); t++)
+        pool[t].join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
@@ -0,0 +1,83 @@
+#ifndef bayesian_transmission_Predictive_h
+#define bayesian_transmission_Predictive_h
+
+#include <stdint.h>
+#include <vector>
+
+#include "util/util.h"
+#include "infect/infect.h"
+#include "modeling/modeling.h"
+#include "lognormal/lognormal.h"
+#include "MCMCChain.h"
+
+/*
+    Posterior predictive simulation.
+
+    The admissions, discharges and tests of the data are kept as they are
+    and the colonization events and test results are simulated forward
+    under each of a set of posterior draws of the model parameters. Only
+    the summary counts asked for are kept from each simulation, per unit
+    and per time bin.
+
+    Forward simulation sets the types of the System's test and admission
+    events and adds colonization events to the history, so each pool
+    thread builds its own System and SystemHistory from the raw event
+    vectors once, and after each simulation takes the added events out and
+    puts the observed types back. Simulation k draws from a XoshiroRandom
+    seeded with XoshiroRandom::streamSeed(seed,k), so the results do not
+    depend on the number of threads.
+
+    Nothing here touches the R API.
+*/
+
+struct PredictiveOptions
+{
+    /// Keep the number of tests, and of positive tests.
+    bool positivity;
+    /// Keep the number of acquisitions in the units.
+    bool acquisitions;
+    /// Width of the time bins, from the first event time.
+    double binwidth;
+    /// Simulations for each draw.
+    unsigned int nreps;
+
+    PredictiveOptions() : positivity(true), acquisitions(true), binwidth(7), nreps(1) {}
+};
+
+/// Counts for each unit and time bin, indexed unit * nbins + bin. Counts
+/// that were not asked for are left empty.
+struct PredictiveCounts
+{
+    std::vector<int> tests;
+    std::vector<int> positives;
+    std::vector<int> acquisitions;
+};
+
+struct PredictiveResult
+{
+    /// Facility and unit ids of the units, in order.
+    std::vector<int> facilities;
+    std::vector<int> units;
+    /// Start of the first time bin, and the number of bins.
+    double start;
+    unsigned int nbins;
+    /// Counts of the data as observed. There are no acquisitions.
+    PredictiveCounts observed;
+    /// Counts of each simulation, nreps for each draw in turn.
+    std::vector<PredictiveCounts> sims;
+};
+
+/// Simulates opt.nreps times under each of draws, values in the order of
+/// modelValues(), on a pool with one thread for each of models. The
+/// models must be alike apart from their values. They are made forward
+/// enabled and their values are overwritten.
+void simulatePredictive(
+    const ChainData &data,
+    std::vector<lognormal::LogNormalModel *> &models,
+    const std::vector< std::vector< std::vector<double> > > &draws,
+    const PredictiveOptions &opt,
+    uint64_t seed,
+    PredictiveResult &res
+);
+
+#endif // bayesian_transmission_Predictive_h
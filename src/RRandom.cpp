@@ -2,39 +2,65 @@
 
 /**
  Random number generators.
+ Single draws go straight to R's generators rather than through Rcpp's
+ vector sugar, which allocates a length one vector per draw. The draws
+ are the same.
  */
 double RRandom::runif(){
     Rcpp::RNGScope rcpp_rngScope_gen;
-    return Rcpp::runif(1)[0];
+    return R::runif(0, 1);
 }
 double RRandom::runif(double a, double b){
     Rcpp::RNGScope rcpp_rngScope_gen;
-    return Rcpp::runif(1, a, b)[0];
+    return R::runif(a, b);
 }
 
 double RRandom::rexp(){
     Rcpp::RNGScope rcpp_rngScope_gen;
-    return Rcpp::rexp(1)[0];
+    return R::exp_rand();
 }
 double RRandom::rexp(double l){
     Rcpp::RNGScope rcpp_rngScope_gen;
-    return Rcpp::rexp(1, l)[0];
+    return R::rexp(1 / l);
 }
 double RRandom::rgamma(double a, double b){
     Rcpp::RNGScope rcpp_rngScope_gen;
-    return Rcpp::rgamma(1, a, b)[0];
+    return R::rgamma(a, b);
 }
 double RRandom::rnorm(){
     Rcpp::RNGScope rcpp_rngScope_gen;
-    return Rcpp::rnorm(1)[0];
+    return R::norm_rand();
 }
 double RRandom::rnorm(double m, double s){
     Rcpp::RNGScope rcpp_rngScope_gen;
-    return Rcpp::rnorm(1, m, s)[0];
+    return R::rnorm(m, s);
 }
 double RRandom::rpoisson(double l){
     Rcpp::RNGScope rcpp_rngScope_gen;
-    return Rcpp::rpois(1, l)[0];
+    return R::rpois(l);
+}
+
+// R only copies its generator state to .Random.seed when the outermost
+// RNGScope ends, so write it out before reading and read it back in
+// after setting it.
+bool RRandom::getState(std::vector<uint64_t> &x) const {
+    PutRNGstate();
+    Rcpp::Environment g = Rcpp::Environment::global_env();
+    if (!g.exists(".Random.seed"))
+        return false;
+    Rcpp::IntegerVector seed = g[".Random.seed"];
+    x.resize(seed.size());
+    for (int i = 0; i < seed.size(); i++)
+        x[i] = (uint32_t) seed[i];
+    return true;
+}
+bool RRandom::setState(const std::vector<uint64_t> &x) {
+    Rcpp::IntegerVector seed(x.size());
+    for (size_t i = 0; i < x.size(); i++)
+        seed[i] = (int) (uint32_t) x[i];
+    Rcpp::Environment::global_env().assign(".Random.seed", seed);
+    GetRNGstate();
+    return true;
 }
 /*
 double RRandom::mcmillerone(int n, double a, double sigma, double p, double q, double r, double s);
@@ -21,6 +21,10 @@ public:
     double rnorm() override;
     double rnorm(double m, double s) override;
     double rpoisson(double l) override;
+
+    // The state is R's .Random.seed.
+    bool getState(std::vector<uint64_t> &x) const override;
+    bool setState(const std::vector<uint64_t> &x) override;
 /*
     double mcmillerone(int n, double a, double sigma, double p, double q, double r, double s);
     void rmiller(double *ab, double p, double q, double r, double s);
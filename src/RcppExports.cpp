@@ -34,8 +34,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // runMCMC
-SEXP runMCMC(Rcpp::DataFrame data, Rcpp::List modelParameters, unsigned int nsims, unsigned int nburn, bool outputparam, bool outputfinal, bool verbose);
-RcppExport SEXP _bayestransmission_runMCMC(SEXP dataSEXP, SEXP modelParametersSEXP, SEXP nsimsSEXP, SEXP nburnSEXP, SEXP outputparamSEXP, SEXP outputfinalSEXP, SEXP verboseSEXP) {
+SEXP runMCMC(Rcpp::DataFrame data, Rcpp::List modelParameters, unsigned int nsims, unsigned int nburn, bool outputparam, bool outputfinal, bool verbose, unsigned int nchains, unsigned int nthreads, Rcpp::Nullable<double> seed, Rcpp::Nullable<Rcpp::CharacterVector> outputfile, Rcpp::Nullable<Rcpp::CharacterVector> checkpoint, unsigned int checkpointevery, bool profile, unsigned int loothin);
+RcppExport SEXP _bayestransmission_runMCMC(SEXP dataSEXP, SEXP modelParametersSEXP, SEXP nsimsSEXP, SEXP nburnSEXP, SEXP outputparamSEXP, SEXP outputfinalSEXP, SEXP verboseSEXP, SEXP nchainsSEXP, SEXP nthreadsSEXP, SEXP seedSEXP, SEXP outputfileSEXP, SEXP checkpointSEXP, SEXP checkpointeverySEXP, SEXP profileSEXP, SEXP loothinSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -46,7 +46,64 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< bool >::type outputparam(outputparamSEXP);
     Rcpp::traits::input_parameter< bool >::type outputfinal(outputfinalSEXP);
     Rcpp::traits::input_parameter< bool >::type verbose(verboseSEXP);
-    rcpp_result_gen = Rcpp::wrap(runMCMC(data, modelParameters, nsims, nburn, outputparam, outputfinal, verbose));
+    Rcpp::traits::input_parameter< unsigned int >::type nchains(nchainsSEXP);
+    Rcpp::traits::input_parameter< unsigned int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable<double> >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable<Rcpp::CharacterVector> >::type outputfile(outputfileSEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable<Rcpp::CharacterVector> >::type checkpoint(checkpointSEXP);
+    Rcpp::traits::input_parameter< unsigned int >::type checkpointevery(checkpointeverySEXP);
+    Rcpp::traits::input_parameter< bool >::type profile(profileSEXP);
+    Rcpp::traits::input_parameter< unsigned int >::type loothin(loothinSEXP);
+    rcpp_result_gen = Rcpp::wrap(runMCMC(data, modelParameters, nsims, nburn, outputparam, outputfinal, verbose, nchains, nthreads, seed, outputfile, checkpoint, checkpointevery, profile, loothin));
+    return rcpp_result_gen;
+END_RCPP
+}
+// resumeMCMC
+SEXP resumeMCMC(Rcpp::DataFrame data, Rcpp::CharacterVector checkpoint, unsigned int nsims, bool outputparam, bool outputfinal, bool verbose, unsigned int nthreads, Rcpp::Nullable<Rcpp::CharacterVector> outputfile, unsigned int checkpointevery, unsigned int loothin);
+RcppExport SEXP _bayestransmission_resumeMCMC(SEXP dataSEXP, SEXP checkpointSEXP, SEXP nsimsSEXP, SEXP outputparamSEXP, SEXP outputfinalSEXP, SEXP verboseSEXP, SEXP nthreadsSEXP, SEXP outputfileSEXP, SEXP checkpointeverySEXP, SEXP loothinSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type data(dataSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type checkpoint(checkpointSEXP);
+    Rcpp::traits::input_parameter< unsigned int >::type nsims(nsimsSEXP);
+    Rcpp::traits::input_parameter< bool >::type outputparam(outputparamSEXP);
+    Rcpp::traits::input_parameter< bool >::type outputfinal(outputfinalSEXP);
+    Rcpp::traits::input_parameter< bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< unsigned int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable<Rcpp::CharacterVector> >::type outputfile(outputfileSEXP);
+    Rcpp::traits::input_parameter< unsigned int >::type checkpointevery(checkpointeverySEXP);
+    Rcpp::traits::input_parameter< unsigned int >::type loothin(loothinSEXP);
+    rcpp_result_gen = Rcpp::wrap(resumeMCMC(data, checkpoint, nsims, outputparam, outputfinal, verbose, nthreads, outputfile, checkpointevery, loothin));
+    return rcpp_result_gen;
+END_RCPP
+}
+// readMCMCTrace
+Rcpp::NumericMatrix readMCMCTrace(std::string path);
+RcppExport SEXP _bayestransmission_readMCMCTrace(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(readMCMCTrace(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// posteriorPredictive
+SEXP posteriorPredictive(Rcpp::DataFrame data, Rcpp::List modelParameters, SEXP draws, unsigned int nreps, Rcpp::CharacterVector stats, double binwidth, unsigned int nthreads, Rcpp::Nullable<double> seed);
+RcppExport SEXP _bayestransmission_posteriorPredictive(SEXP dataSEXP, SEXP modelParametersSEXP, SEXP drawsSEXP, SEXP nrepsSEXP, SEXP statsSEXP, SEXP binwidthSEXP, SEXP nthreadsSEXP, SEXP seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::DataFrame >::type data(dataSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type modelParameters(modelParametersSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type draws(drawsSEXP);
+    Rcpp::traits::input_parameter< unsigned int >::type nreps(nrepsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type stats(statsSEXP);
+    Rcpp::traits::input_parameter< double >::type binwidth(binwidthSEXP);
+    Rcpp::traits::input_parameter< unsigned int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable<double> >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(posteriorPredictive(data, modelParameters, draws, nreps, stats, binwidth, nthreads, seed));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -135,7 +192,10 @@ RcppExport SEXP _rcpp_module_boot_BayesianInfectiousDiseaseModelingModule();
 static const R_CallMethodDef CallEntries[] = {
     {"_bayestransmission_CodeToEvent", (DL_FUNC) &_bayestransmission_CodeToEvent, 1},
     {"_bayestransmission_EventToCode", (DL_FUNC) &_bayestransmission_EventToCode, 1},
-    {"_bayestransmission_runMCMC", (DL_FUNC) &_bayestransmission_runMCMC, 7},
+    {"_bayestransmission_runMCMC", (DL_FUNC) &_bayestransmission_runMCMC, 15},
+    {"_bayestransmission_resumeMCMC", (DL_FUNC) &_bayestransmission_resumeMCMC, 10},
+    {"_bayestransmission_readMCMCTrace", (DL_FUNC) &_bayestransmission_readMCMCTrace, 1},
+    {"_bayestransmission_posteriorPredictive", (DL_FUNC) &_bayestransmission_posteriorPredictive, 8},
     {"_bayestransmission_newModelExport", (DL_FUNC) &_bayestransmission_newModelExport, 2},
     {"_bayestransmission_testHistoryLinkLogLikelihoods", (DL_FUNC) &_bayestransmission_testHistoryLinkLogLikelihoods, 1},
     {"_bayestransmission_newCppModelInternal", (DL_FUNC) &_bayestransmission_newCppModelInternal, 2},
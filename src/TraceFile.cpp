@@ -0,0 +1,181 @@
+#include "TraceFile.h"
+
+#include <string.h>
+#include <stdexcept>
+
+static const char magic[8] = {'B','T','T','R','A','C','E','\0'};
+static const uint32_t version = 1;
+
+// Header fields after the magic, as byte offsets from the start.
+static const uint64_t nusedpos = 24;
+
+static void seek(FILE *f, uint64_t pos, const std::string &path)
+{
+#ifdef _WIN32
+    int err = _fseeki64(f, (__int64) pos, SEEK_SET);
+#else
+    int err = fseeko(f, (off_t) pos, SEEK_SET);
+#endif
+    if (err != 0)
+        throw std::runtime_error("Cannot seek in trace file " + path);
+}
+
+static void get(FILE *f, void *x, size_t size, const std::string &path)
+{
+    if (size > 0 && fread(x, size, 1, f) != 1)
+        throw std::runtime_error("Trace file " + path + " is truncated");
+}
+
+TraceWriter::TraceWriter(const std::string &p, const std::vector<std::string> &names, uint64_t n, unsigned int b)
+{
+    path = p;
+    ncol = names.size();
+    nrow = n;
+    nused = 0;
+    nbuffered = 0;
+    blocksize = b < 1 ? 1 : b;
+    if (nrow > 0 && blocksize > nrow)
+        blocksize = nrow;
+    buffer.resize((size_t) blocksize * ncol);
+
+    f = fopen(path.c_str(), "w+b");
+    if (f == 0)
+        throw std::runtime_error("Cannot open trace file " + path);
+
+    offset = 8 + 4 + 4 + 8 + 8 + 8;
+    for (uint32_t j=0; j<ncol; j++)
+        offset += 4 + names[j].size();
+    offset = (offset + 7) & ~((uint64_t) 7);
+
+    std::vector<char> head(offset, 0);
+    char *h = &head[0];
+    memcpy(h, magic, 8);
+    memcpy(h+8, &version, 4);
+    memcpy(h+12, &ncol, 4);
+    memcpy(h+16, &nrow, 8);
+    memcpy(h+24, &nused, 8);
+    memcpy(h+32, &offset, 8);
+    h += 40;
+    for (uint32_t j=0; j<ncol; j++)
+    {
+        uint32_t len = names[j].size();
+        memcpy(h, &len, 4);
+        memcpy(h+4, names[j].data(), len);
+        h += 4 + len;
+    }
+    put(0, &head[0], head.size());
+}
+
+TraceWriter::~TraceWriter()
+{
+    // Errors can't be thrown from here, so anything still buffered is
+    // only kept if close() was called.
+    if (f != 0)
+        fclose(f);
+}
+
+void TraceWriter::put(uint64_t pos, const void *x, size_t size)
+{
+    seek(f, pos, path);
+    if (size > 0 && fwrite(x, size, 1, f) != 1)
+        throw std::runtime_error("Cannot write to trace file " + path);
+}
+
+void TraceWriter::write(const double *row)
+{
+    if (nused + nbuffered >= nrow)
+        throw std::runtime_error("Trace file " + path + " is full");
+
+    memcpy(&buffer[(size_t) nbuffered * ncol], row, ncol * sizeof(double));
+    if (++nbuffered == blocksize)
+        flush();
+}
+
+void TraceWriter::flush()
+{
+    if (f == 0 || nbuffered == 0)
+        return;
+
+    // Transpose the block so each column goes out in one write.
+    std::vector<double> col(nbuffered);
+    for (uint32_t j=0; j<ncol; j++)
+    {
+        for (unsigned int i=0; i<nbuffered; i++)
+            col[i] = buffer[(size_t) i * ncol + j];
+        put(offset + (j * nrow + nused) * sizeof(double), &col[0], nbuffered * sizeof(double));
+    }
+
+    if (fflush(f) != 0)
+        throw std::runtime_error("Cannot write to trace file " + path);
+
+    nused += nbuffered;
+    nbuffered = 0;
+    put(nusedpos, &nused, 8);
+}
+
+void TraceWriter::close()
+{
+    if (f == 0)
+        return;
+
+    flush();
+    int err = fclose(f);
+    f = 0;
+    if (err != 0)
+        throw std::runtime_error("Cannot write to trace file " + path);
+}
+
+TraceReader::TraceReader(const std::string &p)
+{
+    path = p;
+    f = fopen(path.c_str(), "rb");
+    if (f == 0)
+        throw std::runtime_error("Cannot open trace file " + path);
+
+    try
+    {
+        char m[8];
+        uint32_t v = 0;
+        uint32_t ncol = 0;
+        get(f, m, 8, path);
+        if (memcmp(m, magic, 8) != 0)
+            throw std::runtime_error(path + " is not a trace file");
+        get(f, &v, 4, path);
+        if (v != version)
+            throw std::runtime_error("Trace file " + path + " has an unknown version");
+        get(f, &ncol, 4, path);
+        get(f, &nrow, 8, path);
+        get(f, &nused, 8, path);
+        get(f, &offset, 8, path);
+        if (nused > nrow)
+            throw std::runtime_error("Trace file " + path + " is corrupt");
+
+        for (uint32_t j=0; j<ncol; j++)
+        {
+            uint32_t len = 0;
+            get(f, &len, 4, path);
+            std::string s(len, ' ');
+            get(f, &s[0], len, path);
+            names.push_back(s);
+        }
+    }
+    catch (...)
+    {
+        fclose(f);
+        throw;
+    }
+}
+
+TraceReader::~TraceReader()
+{
+    fclose(f);
+}
+
+void TraceReader::read(unsigned int j, double *x)
+{
+    if (j >= names.size())
+        throw std::out_of_range("Trace file column out of range");
+
+    seek(f, offset + (j * nrow) * sizeof(double), path);
+    get(f, x, nused * sizeof(double), path);
+}
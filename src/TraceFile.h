@@ -0,0 +1,111 @@
+#ifndef bayesian_transmission_TraceFile_h
+#define bayesian_transmission_TraceFile_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+    Binary column file for MCMC traces.
+
+    The file holds a fixed number of named double columns, each with room
+    for a fixed number of rows set when the file is made. Columns are stored
+    one after another, so column j of the rows written so far is a single
+    contiguous read and the whole trace can be read straight into the
+    storage of a column major matrix.
+
+    Layout, in native byte order:
+        char[8]   magic "BTTRACE"
+        uint32    version
+        uint32    number of columns
+        uint64    number of rows there is room for
+        uint64    number of rows written
+        uint64    offset of the data
+        names     for each column a uint32 length then the characters
+        data      the columns, each with room for all the rows
+
+    Rows are buffered and written a block at a time. The count of rows
+    written is only updated after a block is on disk, so a file from a run
+    that was stopped part way through can still be read.
+*/
+
+class TraceWriter
+{
+private:
+    FILE *f;
+    std::string path;
+    uint32_t ncol;
+    uint64_t nrow;
+    uint64_t nused;
+    uint64_t offset;
+
+    // Rows waiting to be written, row by row.
+    std::vector<double> buffer;
+    unsigned int nbuffered;
+    unsigned int blocksize;
+
+    void put(uint64_t pos, const void *x, size_t size);
+
+public:
+
+    /// Makes the file at path with room for nrow rows of the named columns.
+    TraceWriter(const std::string &path, const std::vector<std::string> &names, uint64_t nrow, unsigned int blocksize = 1024);
+    ~TraceWriter();
+
+    /// Adds a row of ncol values.
+    void write(const double *row);
+
+    /// Writes out buffered rows and updates the row count.
+    void flush();
+
+    /// Flushes and closes the file.
+    void close();
+
+    inline uint64_t rows() const
+    {
+        return nused + nbuffered;
+    }
+
+    inline unsigned int columns() const
+    {
+        return ncol;
+    }
+};
+
+class TraceReader
+{
+private:
+    FILE *f;
+    std::string path;
+    std::vector<std::string> names;
+    uint64_t nrow;
+    uint64_t nused;
+    uint64_t offset;
+
+public:
+
+    TraceReader(const std::string &path);
+    ~TraceReader();
+
+    inline const std::vector<std::string> &columnNames() const
+    {
+        return names;
+    }
+
+    inline unsigned int columns() const
+    {
+        return names.size();
+    }
+
+    /// Number of complete rows in the file.
+    inline uint64_t rows() const
+    {
+        return nused;
+    }
+
+    /// Reads all rows of column j into x.
+    void read(unsigned int j, double *x);
+};
+
+#endif // bayesian_transmission_TraceFile_h
@@ -0,0 +1,234 @@
+#include "WAIC.h"
+
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using namespace util;
+using namespace infect;
+using namespace models;
+using namespace lognormal;
+
+PointwiseWAIC::PointwiseWAIC(unsigned int ntests, unsigned int th) :
+    n(0),
+    lmax(ntests, -std::numeric_limits<double>::infinity()),
+    lsum(ntests, 0),
+    mean(ntests, 0),
+    m2(ntests, 0),
+    thin(th),
+    keeping(false)
+{
+}
+
+void PointwiseWAIC::beginDraw()
+{
+    // Draws are kept by their number in the chain, so thinning carries on
+    // in step when the accumulators are restored from a checkpoint.
+    keeping = thin > 0 && n % thin == 0;
+    if (keeping)
+        draws.resize(draws.size() + tests());
+}
+
+void PointwiseWAIC::add(unsigned int j, double logp)
+{
+    // A zero probability adds nothing to the density, and would give NaN
+    // below while lmax is still -Inf.
+    if (logp > lmax[j])
+    {
+        lsum[j] = lsum[j] * exp(lmax[j] - logp) + 1;
+        lmax[j] = logp;
+    }
+    else if (logp > -std::numeric_limits<double>::infinity())
+    {
+        lsum[j] += exp(logp - lmax[j]);
+    }
+
+    double d = logp - mean[j];
+    mean[j] += d / (n + 1);
+    m2[j] += d * (logp - mean[j]);
+
+    if (keeping)
+        draws[draws.size() - tests() + j] = (float) logp;
+}
+
+void PointwiseWAIC::endDraw()
+{
+    n++;
+    keeping = false;
+}
+
+void PointwiseWAIC::merge(const PointwiseWAIC &w)
+{
+    if (w.tests() != tests())
+        throw std::runtime_error("Cannot merge WAIC accumulators for different tests");
+    if (w.n == 0)
+        return;
+
+    double na = n;
+    double nb = w.n;
+    for (unsigned int j=0; j<tests(); j++)
+    {
+        double m = lmax[j] > w.lmax[j] ? lmax[j] : w.lmax[j];
+        if (m > -std::numeric_limits<double>::infinity())
+        {
+            double a = lsum[j] > 0 ? lsum[j] * exp(lmax[j] - m) : 0;
+            double b = w.lsum[j] > 0 ? w.lsum[j] * exp(w.lmax[j] - m) : 0;
+            lsum[j] = a + b;
+            lmax[j] = m;
+        }
+
+        double d = w.mean[j] - mean[j];
+        mean[j] += d * nb / (na + nb);
+        m2[j] += w.m2[j] + d * d * na * nb / (na + nb);
+    }
+    n += w.n;
+
+    draws.insert(draws.end(), w.draws.begin(), w.draws.end());
+}
+
+double PointwiseWAIC::lppd(unsigned int j) const
+{
+    return lmax[j] + log(lsum[j]) - log((double) n);
+}
+
+double PointwiseWAIC::pwaic(unsigned int j) const
+{
+    return n > 1 ? m2[j] / (n - 1) : 0;
+}
+
+double PointwiseWAIC::waic() const
+{
+    double x = 0;
+    for (unsigned int j=0; j<tests(); j++)
+        x += lppd(j) - pwaic(j);
+    return -2 * x;
+}
+
+double PointwiseWAIC::waic1() const
+{
+    double p = 0;
+    double l = 0;
+    for (unsigned int j=0; j<tests(); j++)
+    {
+        p += exp(lppd(j));
+        l += mean[j];
+    }
+    p /= tests();
+    l /= tests();
+    return 2 * log(p) - 4 * l;
+}
+
+double PointwiseWAIC::waic2() const
+{
+    double p = 0;
+    double l = 0;
+    double lsq = 0;
+    for (unsigned int j=0; j<tests(); j++)
+    {
+        p += exp(lppd(j));
+        l += mean[j];
+        lsq += m2[j] / n + mean[j] * mean[j];
+    }
+    p /= tests();
+    l /= tests();
+    lsq /= tests();
+    return -2 * log(p) - 2 * l * l + 2 * lsq;
+}
+
+void PointwiseWAIC::getState(std::vector<double> &x) const
+{
+    x.clear();
+    x.push_back((double) n);
+    x.insert(x.end(), lmax.begin(), lmax.end());
+    x.insert(x.end(), lsum.begin(), lsum.end());
+    x.insert(x.end(), mean.begin(), mean.end());
+    x.insert(x.end(), m2.begin(), m2.end());
+}
+
+void PointwiseWAIC::setState(const std::vector<double> &x)
+{
+    unsigned int m = tests();
+    if (x.size() != 1 + 4 * (size_t) m)
+        throw std::runtime_error("WAIC accumulators do not match the tests");
+
+    n = (uint64_t) x[0];
+    lmax.assign(x.begin() + 1, x.begin() + 1 + m);
+    lsum.assign(x.begin() + 1 + m, x.begin() + 1 + 2*m);
+    mean.assign(x.begin() + 1 + 2*m, x.begin() + 1 + 3*m);
+    m2.assign(x.begin() + 1 + 3*m, x.end());
+    draws.clear();
+}
+
+WAICTests::WAICTests(SystemHistory *hist, LogNormalModel *model)
+{
+    List *tests = hist->getTestLinks();
+    for (tests->init(); tests->hasNext(); )
+    {
+        HistoryLink *h = (HistoryLink *) tests->next();
+        links.push_back(h);
+        if (h->getEvent()->isClinicalTest())
+            types.push_back(model->getClinicalTestParams());
+        else
+            types.push_back(model->getSurveillanceTestParams());
+    }
+    delete tests;
+}
+
+void WAICTests::sample(PointwiseWAIC &w, unsigned int nthreads) const
+{
+    // Tests are handed out in fixed blocks, big enough that starting the
+    // threads is worth it. Each test's accumulators only see that test, so
+    // how the blocks are shared out doesn't change anything.
+    const unsigned int block = 4096;
+    unsigned int m = size();
+    unsigned int nblocks = (m + block - 1) / block;
+
+    w.beginDraw();
+
+    std::atomic<unsigned int> nextblock(0);
+    std::exception_ptr error = 0;
+    std::mutex errorlock;
+
+    auto worker = [&]()
+    {
+        for (unsigned int b = nextblock++; b < nblocks; b = nextblock++)
+        {
+            try
+            {
+                unsigned int end = (b+1) * block < m ? (b+1) * block : m;
+                for (unsigned int j = b * block; j < end; j++)
+                {
+                    HistoryLink *h = links[j];
+                    double p = types[j]->eventProb(h->getPState()->infectionStatus(),h->getPState()->onAbx(),h->getEvent()->getType());
+                    w.add(j, log(p));
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(errorlock);
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+    };
+
+    unsigned int nt = nthreads < 1 ? 1 : nthreads;
+    if (nt > nblocks)
+        nt = nblocks;
+
+    std::vector<std::thread> pool;
+    for (unsigned int t = 1; t < nt; t++)
+        pool.push_back(std::thread(worker));
+    worker();
+    for (unsigned int t = 0; t < pool.size(); t++)
+        pool[t].join();
+
+    if (error)
+        std::rethrow_exception(error);
+
+    w.endDraw();
+}
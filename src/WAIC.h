@@ -0,0 +1,127 @@
+#ifndef bayesian_transmission_WAIC_h
+#define bayesian_transmission_WAIC_h
+
+#include <stdint.h>
+#include <vector>
+
+#include "util/util.h"
+#include "infect/infect.h"
+#include "modeling/modeling.h"
+#include "lognormal/lognormal.h"
+
+/*
+    Pointwise predictive accumulators for WAIC and PSIS-LOO.
+
+    For each test, over the draws of a chain, PointwiseWAIC keeps the log
+    of the summed predictive density, as a running maximum and a sum
+    scaled by it, and the Welford mean and sum of squared deviations of
+    the log density. That is all WAIC needs, in O(ntests) memory with no
+    second pass, and the accumulators of several chains, or of a chain
+    before and after a checkpoint, can be merged exactly.
+
+    If thin is set the log densities of every thin-th draw are also kept,
+    as floats, for PSIS-LOO.
+
+    Nothing here touches the R API.
+*/
+
+class PointwiseWAIC
+{
+private:
+    uint64_t n;
+    std::vector<double> lmax;
+    std::vector<double> lsum;
+    std::vector<double> mean;
+    std::vector<double> m2;
+
+    unsigned int thin;
+    std::vector<float> draws;
+    bool keeping;
+
+public:
+
+    PointwiseWAIC(unsigned int ntests = 0, unsigned int thin = 0);
+
+    inline unsigned int tests() const
+    {
+        return mean.size();
+    }
+
+    /// Number of draws added.
+    inline uint64_t count() const
+    {
+        return n;
+    }
+
+    /// A draw is added by calling beginDraw(), then add() once for each
+    /// test, then endDraw(). Calls to add() for different tests may be made
+    /// at the same time from different threads.
+    void beginDraw();
+    void add(unsigned int j, double logp);
+    void endDraw();
+
+    /// Adds in the draws of w, which must have the same tests.
+    void merge(const PointwiseWAIC &w);
+
+    /// Log pointwise predictive density of test j, and its WAIC penalty,
+    /// the variance of its log density over the draws.
+    double lppd(unsigned int j) const;
+    double pwaic(unsigned int j) const;
+
+    /// -2 times the sum over tests of lppd() - pwaic().
+    double waic() const;
+
+    /// The estimates runMCMC has always given, from the predictive
+    /// density and log density pooled over all tests.
+    double waic1() const;
+    double waic2() const;
+
+    /// The kept log densities, draw by draw, with tests() values for each.
+    inline const std::vector<float> &keptDraws() const
+    {
+        return draws;
+    }
+
+    /// The accumulators, without the kept draws, as a vector for
+    /// checkpoints.
+    void getState(std::vector<double> &x) const;
+    void setState(const std::vector<double> &x);
+};
+
+/*
+    The tests of a history, whose outcomes WAIC predicts, with the test
+    parameters that give their probabilities.
+*/
+
+class WAICTests
+{
+private:
+    std::vector<infect::HistoryLink *> links;
+    std::vector<models::TestParams *> types;
+
+public:
+
+    WAICTests(infect::SystemHistory *hist, lognormal::LogNormalModel *model);
+
+    inline unsigned int size() const
+    {
+        return links.size();
+    }
+
+    inline double time(unsigned int j) const
+    {
+        return links[j]->getEvent()->getTime();
+    }
+
+    inline int patient(unsigned int j) const
+    {
+        return links[j]->getEvent()->getPatient()->getId();
+    }
+
+    /// Adds the log probabilities of the tests under the current state of
+    /// the chain to w as a draw, using up to nthreads threads. The result
+    /// does not depend on the number of threads.
+    void sample(PointwiseWAIC &w, unsigned int nthreads) const;
+};
+
+#endif // bayesian_transmission_WAIC_h
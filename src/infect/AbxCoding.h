@@ -7,8 +7,10 @@
 class AbxCoding
 {
 public:
-    static Map *sysabx;
-    static Map *syseverabx;
+    // System wide abx status of patients. One per thread, so that
+    // independent histories can be sampled on different threads.
+    static thread_local Map *sysabx;
+    static thread_local Map *syseverabx;
 
     enum AbxStatus
     {
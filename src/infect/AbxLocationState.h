@@ -16,8 +16,10 @@ protected:
     int everlat;
 
 public:
-    Map *abx;
-    Map *ever;
+    // Patients on, and ever on, antibiotics. These are shared with the
+    // states they are copied from until changed.
+    PersistentSet *abx;
+    PersistentSet *ever;
 
     AbxLocationState(Object *own, int nstates);
     ~AbxLocationState();
@@ -45,6 +45,11 @@ public:
 		return ph;
 	}
 
+	inline HistoryLink *getHistoryHead() const
+	{
+		return h;
+	}
+
 	int countProposedSwitches() const;
 	int countSwitches() const;
 	int proposalDifferent() const;
@@ -0,0 +1,146 @@
+// infect/FlatHistory.h
+#ifndef ALUN_INFECT_FLATHISTORY_H
+#define ALUN_INFECT_FLATHISTORY_H
+
+#include <vector>
+#include "SystemHistory.h"
+
+/*
+	A flat, read only copy of the unit timelines of a SystemHistory, made
+	for the columnar likelihood.
+	Links are held in struct of arrays columns, unit by unit and in time
+	order within each unit, so that following uNext() is a step to the next
+	entry. The event times and types and the unit census after each event
+	are copied inline so that GapTable can read them without going through
+	the events and states.
+	The copy is only valid until the history is next changed, after which
+	rebuild() must be called.
+*/
+class FlatHistory : public Object
+{
+public:
+	static const unsigned int none = 0xffffffffU;
+
+private:
+
+	SystemHistory *hist;
+
+	// Distinct for every copy made by any FlatHistory, so that things
+	// worked out from a copy can tell when it has been rebuilt.
+	unsigned long version;
+
+	// Units, in the order of SystemHistory::getUnitHeads(), and the
+	// start of each unit's block of links.
+	std::vector<Unit *> units;
+	std::vector<unsigned int> ustart;
+
+	// Per link columns.
+	std::vector<HistoryLink *> link;
+	std::vector<double> time;
+	std::vector<int> type;
+	std::vector<int> unit;
+	std::vector<int> tot;
+	std::vector<int> col;
+	std::vector<int> lat;
+
+public:
+
+	FlatHistory(SystemHistory *h);
+
+	// Copies the current state of the history, reusing storage.
+	void rebuild();
+
+	inline SystemHistory *getSystemHistory() const
+	{
+		return hist;
+	}
+
+	inline unsigned long getVersion() const
+	{
+		return version;
+	}
+
+	inline unsigned int size() const
+	{
+		return link.size();
+	}
+
+	inline int getNUnits() const
+	{
+		return units.size();
+	}
+
+	inline Unit *getUnit(int u) const
+	{
+		return units[u];
+	}
+
+	inline unsigned int unitBegin(int u) const
+	{
+		return ustart[u];
+	}
+
+	inline unsigned int unitEnd(int u) const
+	{
+		return ustart[u+1];
+	}
+
+	inline unsigned int uNext(unsigned int i) const
+	{
+		return i+1 < ustart[unit[i]+1] ? i+1 : none;
+	}
+
+	inline unsigned int uPrev(unsigned int i) const
+	{
+		return i > ustart[unit[i]] ? i-1 : none;
+	}
+
+	inline HistoryLink *getLink(unsigned int i) const
+	{
+		return link[i];
+	}
+
+	inline double getTime(unsigned int i) const
+	{
+		return time[i];
+	}
+
+	inline int getType(unsigned int i) const
+	{
+		return type[i];
+	}
+
+	inline int getUnitIndex(unsigned int i) const
+	{
+		return unit[i];
+	}
+
+	// Unit census after the event at i.
+
+	inline int getTotal(unsigned int i) const
+	{
+		return tot[i];
+	}
+
+	inline int getColonized(unsigned int i) const
+	{
+		return col[i];
+	}
+
+	inline int getLatent(unsigned int i) const
+	{
+		return lat[i];
+	}
+
+	inline int getSusceptible(unsigned int i) const
+	{
+		return tot[i] - col[i] - lat[i];
+	}
+
+	std::string className() const override
+	{
+		return "FlatHistory";
+	}
+};
+
+#endif // ALUN_INFECT_FLATHISTORY_H
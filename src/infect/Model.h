@@ -15,6 +15,7 @@ class HistoryLink;
 class EpisodeHistory;
 
 class SystemHistory;
+class FlatHistory;
 
 class Model : public Object, public EventCoding, public InfectionCoding
 {
@@ -46,5 +47,18 @@ public:
 	virtual void initEpisodeHistory(EpisodeHistory *eh, bool pos) = 0;
 	virtual void sampleEpisodes(SystemHistory *h, int max, Random *r) = 0;
 	virtual void update(SystemHistory *h, Random *r, int max) = 0;
+
+	// Likelihood from a flat copy of the history. By default this uses
+	// the SystemHistory the copy was made from, and the copy is only made
+	// for models that say they use it.
+	virtual double logLikelihood(FlatHistory *h);
+	virtual bool usesFlatHistory() const;
+
+	// Running total of the log likelihood of the history as last updated
+	// and sampled. Returns false if the model doesn't keep one or it is not
+	// current. Changes made to the history other than by sampleEpisodes()
+	// must be followed by resetLogLikelihood().
+	virtual bool runningLogLikelihood(double *x);
+	virtual void resetLogLikelihood();
 };
 #endif // ALUN_INFECT_MODEL_H
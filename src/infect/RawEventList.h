@@ -8,6 +8,61 @@
 
 class RawEventList : public SortedList
 {
+private:
+
+	double first;
+	double last;
+
+	// Builds the list from columns, sorting them once by patient then
+	// time. Events with the same patient and time are left in input order,
+	// which is the order sorted insertion gave them as RawEvent::compare
+	// does not override Object::compare. Input that is already sorted, as
+	// runMCMC requires, is only checked.
+	void build(
+	    const std::vector<int> &facilities,
+	    const std::vector<int> &units,
+	    const std::vector<double> &times,
+	    const std::vector<int> &patients,
+	    const std::vector<int> &types
+	)
+	{
+		size_t n = facilities.size();
+
+		auto before = [&](size_t i, size_t j)
+		{
+			if (patients[i] != patients[j])
+				return patients[i] < patients[j];
+			return times[i] < times[j];
+		};
+
+		std::vector<size_t> order(n);
+		for (size_t i=0; i<n; i++)
+			order[i] = i;
+
+		bool sorted = true;
+		for (size_t i=1; sorted && i<n; i++)
+			if (before(i,i-1))
+				sorted = false;
+
+		if (!sorted)
+			std::stable_sort(order.begin(),order.end(),before);
+
+		first = 0;
+		last = 0;
+		for (size_t i=0; i<n; i++)
+		{
+			size_t k = order[i];
+			List::append(new RawEvent(facilities[k],units[k],times[k],patients[k],types[k]));
+
+			if (i == 0 || times[k] < first)
+				first = times[k];
+			if (i == 0 || times[k] > last)
+				last = times[k];
+		}
+
+		init();
+	}
+
 public:
 
 	static const int maxline = 1000;
@@ -16,6 +71,12 @@ public:
 	{
 		char *c = new char[maxline];
 
+		std::vector<int> facilities;
+		std::vector<int> units;
+		std::vector<double> times;
+		std::vector<int> patients;
+		std::vector<int> types;
+
 		for (int line=1; !is.eof(); line++)
 		{
 			is.getline(c,maxline);
@@ -35,20 +96,24 @@ public:
 				continue;
 			}
 
-			append(new RawEvent(facility,unit,time,patient,type));
+			facilities.push_back(facility);
+			units.push_back(unit);
+			times.push_back(time);
+			patients.push_back(patient);
+			types.push_back(type);
 		}
 
-		init();
+		build(facilities,units,times,patients,types);
 
 		delete [] c;
 	}
 
 	RawEventList(
-	    std::vector<int> facilities,
-	    std::vector<int> units,
-	    std::vector<double> times,
-	    std::vector<int> patients,
-	    std::vector<int> types
+	    const std::vector<int> &facilities,
+	    const std::vector<int> &units,
+	    const std::vector<double> &times,
+	    const std::vector<int> &patients,
+	    const std::vector<int> &types
     ) : SortedList()
 	{
 
@@ -57,13 +122,7 @@ public:
             throw std::invalid_argument("All vectors must have the same size");
         }
 
-	    for (auto i=0UL; i < facilities.size(); i++)
-	    {
-	        append(new RawEvent(facilities[i],units[i],times[i],patients[i],types[i]));
-	    }
-
-	    init();
-
+	    build(facilities,units,times,patients,types);
 	}
 
 	~RawEventList()
@@ -78,37 +137,12 @@ public:
 
 	double firstTime()
 	{
-		double x = 0;
-		init();
-		if (hasNext())
-			x = (dynamic_cast<RawEvent *>(next()))->getTime();
-
-		for (init(); hasNext(); )
-		{
-			double y = (dynamic_cast<RawEvent *>(next()))->getTime();
-			if (y < x)
-				x = y;
-		}
-
-		return x;
+		return first;
 	}
 
 	double lastTime()
 	{
-		double x = 0;
-		init();
-		if (hasNext())
-			x = (dynamic_cast<RawEvent *>(next()))->getTime();
-
-
-		for (init(); hasNext(); )
-		{
-			double y = (dynamic_cast<RawEvent *>(next()))->getTime();
-			if (y > x)
-				x = y;
-		}
-
-		return x;
+		return last;
 	}
 
 	// virtual void write(ostream &os) override
@@ -13,15 +13,31 @@ private:
 	Model *model;
 	Random *rand;
 
+	// Flat copy of the history for models that use one, made when the
+	// likelihood is next asked for after the episodes have been sampled.
+	FlatHistory *flat;
+	bool flatstale;
+
+	FlatHistory *getFlatHistory();
+
 public:
 
 	Sampler(SystemHistory *h, Model *m, Random *r);
+	~Sampler();
 
 	virtual void sampleModel();
 	virtual void sampleModel(int max);
 	virtual void sampleEpisodes();
 	virtual void sampleEpisodes(int max);
 	void initializeEpisodes();
+
+	// Call after the history or model has been changed other than by this
+	// sampler, for instance when restoring a checkpoint.
+	void historyChanged();
+
+	// Log likelihood of the current history under the current model,
+	// using the model's running total when it has one.
+	virtual double logLikelihood();
 };
 
 #endif // ALUN_INFECT_SAMPLER_H
@@ -31,6 +31,7 @@ private:
 	void handleOutOfRangeEvent(Patient *p, int t);
 	void init(RawEventList *l, stringstream &err);
 	void setInsitus();
+	void indexUnits();
 
 protected:
     stringstream errlog;
@@ -41,11 +42,11 @@ public:
 	System(RawEventList *l, stringstream &err);
 	System(istream &is, stringstream &err);
 	System(
-	    std::vector<int> facilities,
-        std::vector<int> units,
-        std::vector<double> times,
-        std::vector<int> patients,
-        std::vector<int> types
+	    const std::vector<int> &facilities,
+        const std::vector<int> &units,
+        const std::vector<double> &times,
+        const std::vector<int> &patients,
+        const std::vector<int> &types
 	);
 	~System();
 	std::shared_ptr<Map> getEpisodes(Patient *p);
@@ -78,6 +78,8 @@ public:
 	}
 
 	EpisodeHistory** getPatientHistory(Patient *pat, int *n);
+	// Fills eps, if not null, and returns the number of episodes.
+	int fillPatientHistory(Patient *pat, EpisodeHistory **eps);
 	List* getTestLinks();
 	Map* positives();
 	int sumocc();
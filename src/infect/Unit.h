@@ -9,12 +9,14 @@ class Unit : public Object
 private:
 
 	int number;
+	int index;
 	Object *f;
 
 public:
 	Unit(Object *fac, int id)
 	{
 		number = id;
+		index = -1;
 		f = fac;
 	}
 
@@ -23,16 +25,35 @@ public:
 		return number;
 	}
 
+	// Dense index of the unit within its System, 0 to nunits-1, in order
+	// of facility id then unit id. Set by System once all units are made.
+	inline int getIndex() const
+	{
+		return index;
+	}
+
+	inline void setIndex(int i)
+	{
+		index = i;
+	}
+
+	inline Object *getFacility() const
+	{
+		return f;
+	}
+
 	inline string getName() const
 	{
 		stringstream ss;
-		ss << f << ":" << number;
+		f->write(ss);
+		ss << ":" << number;
 		return ss.str();
 	}
 
 	void write(ostream &os) const override
 	{
-        	os << f << ":" << number;
+        	f->write(os);
+        	os << ":" << number;
 	}
 };
 
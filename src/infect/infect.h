@@ -11,6 +11,7 @@
         #include <stdexcept>
 	#include <complex>
 	#include <memory>
+	#include <algorithm>
         using namespace std;
 
     #include "../util/util.h"
@@ -60,6 +61,7 @@
 		#include "FacilityEpisodeHistory.h"
 		#include "UnitEpisodeHistory.h"
 		#include "SystemHistory.h"
+		#include "FlatHistory.h"
 
 	// Class to run MCMC sampler.
 
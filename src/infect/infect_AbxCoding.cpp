@@ -1,7 +1,12 @@
 #include "infect/infect.h"
 
-Map *infect::AbxCoding::sysabx = new Map();
-Map *infect::AbxCoding::syseverabx = new Map();
+// The maps themselves are thread_local objects so that they are freed
+// when a sampling thread exits.
+static thread_local Map sysabxmap;
+static thread_local Map syseverabxmap;
+thread_local Map *infect::AbxCoding::sysabx = &sysabxmap;
+thread_local Map *infect::AbxCoding::syseverabx = &syseverabxmap;
+
 string infect::AbxCoding::abxCodeString(AbxStatus x)
 {
     switch (x)
@@ -3,10 +3,10 @@
 
 infect::AbxLocationState::AbxLocationState(Object *own, int nstates) : CountLocationState(own, nstates)
 {
-    abx = new Map();
+    abx = new PersistentSet();
     abxinf = 0;
     abxlat = 0;
-    ever = new Map();
+    ever = new PersistentSet();
     everinf = 0;
     everlat = 0;
 }
@@ -32,14 +32,10 @@ void infect::AbxLocationState::copy(State *s)
 {
     CountLocationState::copy(s);
     AbxLocationState *as = (AbxLocationState *)s;
-    abx->clear();
-    for (as->abx->init(); as->abx->hasNext();)
-        abx->add(as->abx->next());
+    abx->copy(as->abx);
     abxinf = as->abxinf;
     abxlat = as->abxlat;
-    ever->clear();
-    for (as->ever->init(); as->ever->hasNext();)
-        ever->add(as->ever->next());
+    ever->copy(as->ever);
     everinf = as->everinf;
     everlat = as->everlat;
 }
@@ -124,11 +124,21 @@ void EpisodeHistory::installProposal()
 
 void EpisodeHistory::appendLink(HistoryLink *l)
 {
-    unapply();
-    installProposal();
-    proposeSwitch(l);
-    installProposal();
-    apply();
+    // apply() takes the links in order, so it would apply l after the
+    // links already in place. Applying l alone gives the same states
+    // without undoing and redoing the whole episode.
+    l->setHNext(0);
+    l->setHPrev(t);
+    if (t == 0)
+        h = l;
+    else
+        t->setHNext(l);
+    t = l;
+
+    if (l->isLinked())
+        applyAndInsert(l);
+    else
+        applyInitialEvent(l->getEvent());
 }
 
 void EpisodeHistory::apply()
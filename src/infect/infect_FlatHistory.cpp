@@ -0,0 +1,53 @@
+#include "infect/infect.h"
+#include <atomic>
+
+namespace infect {
+
+const unsigned int FlatHistory::none;
+
+static std::atomic<unsigned long> nbuilds(0);
+
+FlatHistory::FlatHistory(SystemHistory *h)
+{
+    hist = h;
+    rebuild();
+}
+
+void FlatHistory::rebuild()
+{
+    version = ++nbuilds;
+
+    units.clear();
+    ustart.clear();
+    link.clear();
+    time.clear();
+    type.clear();
+    unit.clear();
+    tot.clear();
+    col.clear();
+    lat.clear();
+
+    for (Map *h = hist->getUnitHeads(); h->hasNext(); )
+    {
+        Unit *u = (Unit *) h->next();
+        int k = units.size();
+        units.push_back(u);
+        ustart.push_back(link.size());
+
+        for (HistoryLink *l = (HistoryLink *) h->get(u); l != 0; l = l->uNext())
+        {
+            link.push_back(l);
+            time.push_back(l->getEvent()->getTime());
+            type.push_back(l->getEvent()->getType());
+            unit.push_back(k);
+
+            LocationState *s = l->getUState();
+            tot.push_back(s == 0 ? 0 : s->getTotal());
+            col.push_back(s == 0 ? 0 : s->getColonized());
+            lat.push_back(s == 0 ? 0 : s->getLatent());
+        }
+    }
+    ustart.push_back(link.size());
+}
+
+} // namespace infect
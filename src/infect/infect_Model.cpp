@@ -56,4 +56,23 @@ void Model::handleAbxDoses(HistoryLink *shead)
 {
 }
 
+double Model::logLikelihood(FlatHistory *h)
+{
+    return logLikelihood(h->getSystemHistory());
+}
+
+bool Model::usesFlatHistory() const
+{
+    return false;
+}
+
+bool Model::runningLogLikelihood(double *x)
+{
+    return false;
+}
+
+void Model::resetLogLikelihood()
+{
+}
+
 } // namespace infect
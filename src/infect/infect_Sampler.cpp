@@ -3,11 +3,37 @@
 namespace infect {
 
 Sampler::Sampler(SystemHistory *h, Model *m, Random *r)
-    : hist(h), model(m), rand(r)
+    : hist(h), model(m), rand(r), flat(0), flatstale(true)
 {
     initializeEpisodes();
 }
 
+Sampler::~Sampler()
+{
+    if (flat != 0)
+        delete flat;
+}
+
+FlatHistory *Sampler::getFlatHistory()
+{
+    if (flat == 0)
+        flat = new FlatHistory(hist);
+    else if (flatstale)
+        flat->rebuild();
+    flatstale = false;
+    return flat;
+}
+
+double Sampler::logLikelihood()
+{
+    double x = 0;
+    if (model->runningLogLikelihood(&x))
+        return x;
+    if (model->usesFlatHistory())
+        return model->logLikelihood(getFlatHistory());
+    return model->logLikelihood(hist);
+}
+
 
 void Sampler::sampleModel()
 {
@@ -16,6 +42,7 @@ void Sampler::sampleModel()
 
 void Sampler::sampleModel(int max)
 {
+    Profile::Scope timer(Profile::SampleModel);
     model->update(hist,rand,max);
 }
 
@@ -27,11 +54,21 @@ void Sampler::sampleEpisodes()
 
 void Sampler::sampleEpisodes(int max)
 {
+    Profile::Scope timer(Profile::SampleEpisodes);
     model->sampleEpisodes(hist,max,rand);
+    flatstale = true;
+}
+
+void Sampler::historyChanged()
+{
+    flatstale = true;
+    model->resetLogLikelihood();
 }
 
 void Sampler::initializeEpisodes()
 {
+    flatstale = true;
+    model->resetLogLikelihood();
     Map *pos = hist->positives();
     for (Map *e = hist->getEpisodes(); e->hasNext();)
     {
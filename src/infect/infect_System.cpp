@@ -16,6 +16,31 @@ void System::init(RawEventList *l, stringstream &err)
     end = (int) (0.99999999 + l->lastTime());
     makeAllEpisodes(l,err);
     setInsitus();
+    indexUnits();
+}
+
+// Give the units dense indexes in order of facility id then unit id, so that
+// models can keep per unit values in arrays. The order only depends on which
+// units are in the data, so every System made from the same data agrees.
+void System::indexUnits()
+{
+    std::vector<Unit *> u;
+    for (fac->init(); fac->hasNext(); )
+    {
+        Facility *f = (Facility *) fac->nextValue();
+        for (IntMap *m = f->getUnits(); m->hasNext(); )
+            u.push_back((Unit *) m->nextValue());
+    }
+
+    std::sort(u.begin(), u.end(), [](Unit *a, Unit *b)
+    {
+        int fa = ((Facility *) a->getFacility())->getId();
+        int fb = ((Facility *) b->getFacility())->getId();
+        return fa != fb ? fa < fb : a->getId() < b->getId();
+    });
+
+    for (unsigned int i=0; i<u.size(); i++)
+        u[i]->setIndex(i);
 }
 
 void System::setInsitus()
@@ -74,11 +99,11 @@ System::System(istream &is, stringstream &err)
 }
 
 System::System(
-    std::vector<int> facilities,
-    std::vector<int> units,
-    std::vector<double> times,
-    std::vector<int> patients,
-    std::vector<int> types
+    const std::vector<int> &facilities,
+    const std::vector<int> &units,
+    const std::vector<double> &times,
+    const std::vector<int> &patients,
+    const std::vector<int> &types
 )
 {
 
@@ -3,6 +3,29 @@
 
 namespace infect {
 
+namespace {
+
+// Next link of a patient's timeline while merging the timelines. The heap
+// is a max heap, so the order is reversed to put the earliest time, then
+// the smallest order, on top.
+struct MergeHead
+{
+    HistoryLink *link;
+    double time;
+    long order;
+
+    MergeHead(HistoryLink *x, long o) : link(x), time(x->getEvent()->getTime()), order(o) {}
+
+    bool operator<(const MergeHead &y) const
+    {
+        if (time != y.time)
+            return time > y.time;
+        return order > y.order;
+    }
+};
+
+} // namespace
+
 HistoryLink* SystemHistory::makeHistoryLink(Model *mod, Event *e)
 {
     if (mod == 0)
@@ -187,50 +210,35 @@ SystemHistory::SystemHistory(System *s, Model *m, bool verbose)
         hx[hxn++] = (HistoryLink *) pheads->get(patient);
     }
 
+    // Merge the patient timelines into the system, facility and unit lists
+    // in time order, taking the earliest next link from a heap. Ties go as
+    // the old insertion sort left them: first the patients' first links in
+    // patient order, then links reached by stepping along a timeline, the
+    // most recently reached first.
+
+    std::vector<MergeHead> heap;
+    heap.reserve(hxn);
     for (int i=0; i<hxn; i++)
-    {
-        for (int j=i; j>0; j--)
-        {
-            if (hx[j]->getEvent()->getTime() < hx[j-1]->getEvent()->getTime())
-            {
-                HistoryLink *y = hx[j-1];
-                hx[j-1] = hx[j];
-                hx[j] = y;
-            }
-            else
-            {
-                break;
-            }
-        }
-    }
+        heap.push_back(MergeHead(hx[i],i));
+    std::make_heap(heap.begin(),heap.end());
+
+    long step = 0;
 
-    for (int i=0; i<hxn; )
+    while (!heap.empty())
     {
-        hx[i]->insertBeforeS(stail);
-        hx[i]->insertBeforeF((HistoryLink *)tails->get(hx[i]->getEvent()->getFacility()));
-        hx[i]->insertBeforeU((HistoryLink *)tails->get(hx[i]->getEvent()->getUnit()));
+        std::pop_heap(heap.begin(),heap.end());
+        HistoryLink *x = heap.back().link;
+        heap.pop_back();
 
-        hx[i] = hx[i]->pNext();
+        x->insertBeforeS(stail);
+        x->insertBeforeF((HistoryLink *)tails->get(x->getEvent()->getFacility()));
+        x->insertBeforeU((HistoryLink *)tails->get(x->getEvent()->getUnit()));
 
-        if (hx[i] == 0)
+        x = x->pNext();
+        if (x != 0)
         {
-            i++;
-        }
-        else
-        {
-            for (int j=i+1; j<hxn; j++)
-            {
-                if (hx[j]->getEvent()->getTime() < hx[j-1]->getEvent()->getTime())
-                {
-                    HistoryLink *y = hx[j-1];
-                    hx[j-1] = hx[j];
-                    hx[j] = y;
-                }
-                else
-                {
-                    break;
-                }
-            }
+            heap.push_back(MergeHead(x,--step));
+            std::push_heap(heap.begin(),heap.end());
         }
     }
 
@@ -311,20 +319,26 @@ SystemHistory::SystemHistory(System *s, Model *m, bool verbose)
 }
 
 EpisodeHistory** SystemHistory::getPatientHistory(Patient *pat, int *n)
+{
+    *n = fillPatientHistory(pat,0);
+    EpisodeHistory **eps = new EpisodeHistory*[*n];
+    fillPatientHistory(pat,eps);
+    return eps;
+}
+
+int SystemHistory::fillPatientHistory(Patient *pat, EpisodeHistory **eps)
 {
     int k = 0;
     for (HistoryLink *l = (HistoryLink *) pheads->get(pat); l != 0; l = l->pNext())
+    {
         if (l->getEvent()->isAdmission() || l->getEvent()->isInsitu())
+        {
+            if (eps != 0)
+                eps[k] = (EpisodeHistory *) ep2ephist->get(adm2ep->get(l));
             k++;
-    *n = k;
-
-    EpisodeHistory **eps = new EpisodeHistory*[k];
-    k = 0;
-    for (HistoryLink *l = (HistoryLink *) pheads->get(pat); l != 0; l = l->pNext())
-        if (l->getEvent()->isAdmission() || l->getEvent()->isInsitu())
-            eps[k++] = (EpisodeHistory *) ep2ephist->get(adm2ep->get(l));
-
-    return eps;
+        }
+    }
+    return k;
 }
 
 List* SystemHistory::getTestLinks()
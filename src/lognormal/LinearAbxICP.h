@@ -9,6 +9,16 @@ protected:
 
     static constexpr double timepartol = 0.000000001;
 
+    // Adds w times the gradient of getRate(i,...) to g[i].
+    void rateGradient(int i, int risk, int ever, int cur, double w, double **g);
+    // Adds w times the gradient of acqRate(...,tOrigin) to g[0], except for
+    // the time parameter, and returns the rate.
+    double acqGradient(int nsus, int onabx, int everabx, int ncolabx, int ncol, int tot, double w, double **g);
+
+    virtual bool hasGradient() const override;
+    virtual void eventGradient(PatternStats &es, double **g) override;
+    virtual void gapGradient(PatternStats &gs, double gaptrend, double **g) override;
+
 public:
     using LogNormalICP::set;
 
@@ -27,9 +37,15 @@ public:
     virtual double logClearanceGap(double t0, double t1, LocationState *s) override;
     virtual double logAcquisitionRate(double time, PatientState *p, LocationState *ls) override;
     virtual double logAcquisitionGap(double u, double v, LocationState *ls) override;
-    virtual double *acquisitionRates(double time, PatientState *p, LocationState *ls) override;
+    virtual double *acquisitionRates(double time, PatientState *p, LocationState *ls, double *P) override;
+    virtual double acquisitionGapRate(LocationState *ls) override;
+    virtual double acquisitionTrend() override;
 
     virtual double unTransform(int i, int j) override;
+    virtual double transform(int i, int j, double x) override;
+
+// Implement Parameters.
+    virtual double logProbGaps(const GapTable &t) override;
 };
 
 
@@ -24,7 +24,9 @@ public:
     virtual double logClearanceGap(double t0, double t1, LocationState *s) override;
     virtual double logAcquisitionRate(double time, PatientState *p, LocationState *ls) override;
     virtual double logAcquisitionGap(double u, double v, LocationState *ls) override;
-    virtual double *acquisitionRates(double time, PatientState *p, LocationState *ls) override;
+    virtual double *acquisitionRates(double time, PatientState *p, LocationState *ls, double *P) override;
+    virtual double acquisitionGapRate(LocationState *ls) override;
+    virtual double acquisitionTrend() override;
 
     virtual double unTransform(int i, int j) override;
 
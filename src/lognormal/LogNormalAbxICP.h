@@ -42,6 +42,8 @@ public:
 protected:
 
 	virtual double timePar();
+	// Index in par[0] of the time parameter used for gap exposures.
+	virtual int timeIndex() const;
 
     /// Log Acquisition Rate
     /// \param time Time of acquisition.
@@ -57,6 +59,10 @@ protected:
 	virtual double clearRate(int onabx, int ever);
 	virtual double logClearRate(int onabx, int ever);
 
+	virtual bool hasGradient() const override;
+	virtual void eventGradient(PatternStats &es, double **g) override;
+	virtual void gapGradient(PatternStats &gs, double gaptrend, double **g) override;
+
 public:
 
 	LogNormalAbxICP(int nst, int isDensity, int nmet, int cap=8);
@@ -70,8 +76,14 @@ public:
 	virtual double logClearanceGap(double t0, double t1, LocationState *s) override;
 	virtual double logAcquisitionRate(double time, PatientState *p, LocationState *ls) override;
 	virtual double logAcquisitionGap(double u, double v, LocationState *ls) override;
-	virtual double *acquisitionRates(double time, PatientState *p, LocationState *ls) override;
+	virtual double *acquisitionRates(double time, PatientState *p, LocationState *ls, double *P) override;
+	virtual double acquisitionGapRate(LocationState *ls) override;
+	virtual double acquisitionTrend() override;
+	virtual double acquisitionGapTrend() override;
     virtual std::vector<std::string> paramNames() const override;
 
+// Implement Parameters.
+	virtual double logProbGaps(const GapTable &t) override;
+
 };
 #endif // ALUN_LOGNORMAL_LOGNORMALABXICP_H
@@ -20,9 +20,64 @@ protected:
 	double **pristdev; //< Prior standard deviation.
 	double **sigmaprop; //< Proposal standard deviation.
 	int **doit; //< Update flag.
+	int **nproposed; //< Metropolis-Hastings proposals made.
+	int **naccepted; //< Metropolis-Hastings proposals accepted.
+	double nadapt; //< Adaptive sweeps made.
+	bool adapting;
+
+	// Joint updates of each row of parameters.
+	bool block; //< Update each row jointly.
+	double *blockscale; //< Scale of each row's joint proposal.
+	double *nblock; //< Adaptive joint proposals made for each row.
+	double **blockmean; //< Running mean of each row while adapting.
+	double ***blockss; //< Running sums of squares and products about blockmean.
+
+	// Hamiltonian Monte Carlo updates of all the parameters.
+	bool hmc; //< Use HMC rather than random walk proposals.
+	double hmcstep; //< Leapfrog step size, in units of sigmaprop.
+	static const int nleapfrog = 10; //< Leapfrog steps per trajectory.
 	double tOrigin; //< Time origin.
+	std::vector<double> gaprate; //< Per gap acquisition rates for logProbGaps().
 	int nmetro; //< Number of Metropolis-Hastings iterations.
-	Map *m;
+
+	// Sufficient statistics for logpost().
+	// The rates only depend on a link through its event type, its unit,
+	// the patient's abx status, the unit census and the event time, so
+	// events and gaps are pooled by that covariate pattern in countGap().
+	// A proposal is then scored in O(patterns) rather than O(links).
+
+	static const int npattern = 14;
+	typedef std::array<int,npattern> Pattern;
+
+	struct PatternStats
+	{
+		HistoryLink *link;	//< First link with the pattern. Its states are used to evaluate the rates.
+		int n;			//< Number of events.
+		double sumt;		//< Sum of event times less the time origin.
+		double dt;		//< Total length of the gaps.
+		std::vector<double> u;	//< Gap start times, for time trend exposures.
+		std::vector<double> v;	//< Gap end times.
+		double trend;		//< Trend of the cached exposure.
+		double expo;		//< Cached exposure.
+	};
+
+	std::map<Pattern,PatternStats> events;
+	std::map<Pattern,PatternStats> gaps;
+
+	// Events and gaps found in part of the history. The patterns include
+	// the unit, so those of different units never meet.
+	class PatternCounts : public Counts
+	{
+	public:
+		std::map<Pattern,PatternStats> events;
+		std::map<Pattern,PatternStats> gaps;
+	};
+
+	void countGap(HistoryLink *g, HistoryLink *h, std::map<Pattern,PatternStats> &ev, std::map<Pattern,PatternStats> &gp);
+	static void addStats(std::map<Pattern,PatternStats> &to, std::map<Pattern,PatternStats> &from);
+
+	void setPattern(Pattern &x, int type, Patient *p, LocationState *s);
+	double exposure(PatternStats &x, double trend);
 
 	string **pnames;
 
@@ -34,6 +89,25 @@ protected:
 
 	virtual void initParameterNames();
 
+	// Joint Metropolis-Hastings update of row i, returning the new log
+	// posterior.
+	double updateBlock(Random *r, bool max, int i, double oldlogpost);
+	// Cholesky factor L of the proposal covariance of row i, before
+	// scaling by blockscale[i].
+	void blockFactor(int i, double **L);
+	// HMC update of all the updated parameters, returning the new log
+	// posterior.
+	double updateHMC(Random *r, double oldlogpost);
+
+	// Analytic gradients of the terms of logpost(), added to g, for
+	// subclasses that override hasGradient(). Otherwise logpostGradient()
+	// uses finite differences.
+	virtual bool hasGradient() const;
+	virtual void eventGradient(PatternStats &es, double **g);
+	virtual void gapGradient(PatternStats &gs, double gaptrend, double **g);
+	// Derivative of exposure(x,trend) with respect to trend.
+	double exposureGradient(PatternStats &x, double trend);
+
 public:
 
 	LogNormalICP(int k, int napar, int nppar, int ncpar, int nmet = 10);
@@ -45,12 +119,21 @@ public:
 	double getTimeOrigin();
 
 	virtual double logpost(Random *r, int max);
+	// Gradient of logpost() with respect to the updated parameters par,
+	// into g. The others are set to 0.
+	void logpostGradient(Random *r, int max, double **g);
+	// As logpostGradient(), but by central differences of logpost(),
+	// which is what it uses for subclasses without analytic gradients.
+	void numericGradient(Random *r, int max, double **g);
+	// logpostGradient(), or numericGradient() if numeric is set, in the
+	// order of paramNames().
+	std::vector<double> getGradient(Random *r, bool numeric);
 
 // Sufficient to implement LogNormalICP.
 
 	virtual double logAcquisitionRate(double time, PatientState *p, LocationState *s) = 0;
 	virtual double logAcquisitionGap(double t0, double t1, LocationState *s) = 0;
-	virtual double* acquisitionRates(double time, PatientState *p, LocationState *s) override = 0;
+	virtual double* acquisitionRates(double time, PatientState *p, LocationState *s, double *P) override = 0;
 
 	virtual double logProgressionRate(double time, PatientState *p, LocationState *s) = 0;
 	virtual double logProgressionGap(double t0, double t1, LocationState *s) = 0;
@@ -58,7 +141,19 @@ public:
 	virtual double logClearanceRate(double time, PatientState *p, LocationState *s) = 0;
 	virtual double logClearanceGap(double t0, double t1, LocationState *s) = 0;
 
+// Needed for the sufficient statistics.
+// The acquisition rate at time t is the rate at the time origin times exp(trend * (t-tOrigin)).
+
+	virtual double acquisitionGapRate(LocationState *s) = 0;
+	virtual double acquisitionTrend();
+	virtual double acquisitionGapTrend();
+	double timeExposure(double trend, double t0, double t1);
+	// Sum over the gaps in t of rate[i] times the gap's timeExposure().
+	double gapExposure(const GapTable &t, const double *rate, double trend);
+
 	virtual double unTransform(int i, int j);
+	// Inverse of unTransform(), the log parameter for value x.
+	virtual double transform(int i, int j, double x);
 
 // Personal accessors.
 
@@ -73,10 +168,27 @@ public:
 
 	virtual int nParam() const;
 
+	// Metropolis-Hastings proposals made and accepted for each parameter
+	// since the last clearAcceptance(), in the order of paramNames().
+	void getAcceptance(std::vector<int> &proposed, std::vector<int> &accepted) const;
+	void clearAcceptance();
+
+	// If set, update() proposes all the updated parameters of a row,
+	// acquisition, progression or clearance, at once. While adapting, the
+	// proposal covariance is learned from the chain.
+	inline bool isBlockUpdate() const {return block;}
+	inline void setBlockUpdate(bool b) {block = b;}
+
+	// If set, update() moves all the updated parameters at once along
+	// Hamiltonian trajectories, with the proposal scales as the inverse
+	// mass matrix. While adapting, the step size is tuned.
+	inline bool isHMC() const {return hmc;}
+	inline void setHMC(bool h) {hmc = h;}
+
 // Implement InColParams.
 
     virtual double eventRate(double time, EventCode c, PatientState *p, LocationState *s) override;
-	virtual double **rateMatrix(double time, PatientState *p, LocationState *u) override;
+	virtual double **rateMatrix(double time, PatientState *p, LocationState *u, double **Q) override;
 
 // Implement Parameters.
 	virtual std::vector<std::string> paramNames() const override;
@@ -86,6 +198,14 @@ public:
 	virtual void initCounts() override;
 	virtual void count(HistoryLink *h) override;
 	virtual void countGap(HistoryLink *g, HistoryLink *h) override;
+	virtual Counts *newCounts() override;
+	virtual void countGapInto(HistoryLink *g, HistoryLink *h, Counts *c) override;
+	virtual void addCounts(Counts *c) override;
 	virtual void update(Random *r, bool max) override;
+	virtual double countedLogLikelihood() override;
+	virtual std::vector<double> getState() const override;
+	virtual void setState(const std::vector<double> &x) override;
+	virtual void setValues(const std::vector<double> &x) override;
+	virtual void setAdapting(bool a) override;
 };
 #endif // ALUN_LOGNORMAL_LOGNORMALCP_H
@@ -29,6 +29,7 @@ public:
 	virtual double logClearanceGap(double t0, double t1, LocationState *s) override;
 	virtual double logAcquisitionRate(double time, PatientState *p, LocationState *s) override;
 	virtual double logAcquisitionGap(double t0, double t1, LocationState *s) override;
-	virtual double* acquisitionRates(double time, PatientState *p, LocationState *s) override;
+	virtual double* acquisitionRates(double time, PatientState *p, LocationState *s, double *P) override;
+	virtual double acquisitionGapRate(LocationState *s) override;
 };
 #endif // ALUN_LOGNORMAL_LOGNORMALMASSACT_H
@@ -3,7 +3,7 @@
 
 #include "../modeling/modeling.h"
 #include "LogNormalAbxICP.h"
-// #include "MultiUnitAbxICP.h"
+#include "MultiUnitAbxICP.h"
 
 
 class LogNormalModel : public BasicModel
@@ -17,6 +17,7 @@ protected:
 public:
 
 	LogNormalModel(int nst, int abxtest, int nmetro, int fw = 0, int ch = 0);
+    // With a list of units, l, the acquisition model is a MultiUnitAbxICP.
     LogNormalModel(List *l, int nst, int abxtest, int nmetro, int fw = 0, int ch = 0);
     ~LogNormalModel();
 
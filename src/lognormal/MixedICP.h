@@ -20,7 +20,9 @@ public:
 
 	double acqRate(double time, int onabx, int everabx, double ncolabx, double ncol, double tot);
 	virtual double timePar() override;
+	virtual int timeIndex() const override;
 	virtual double unTransform(int i, int j) override;
+	virtual double transform(int i, int j, double x) override;
 	virtual void set(int i, int j, double value, int update, double prival, double priorn) override;
 };
 #endif // ALUN_LOGNORMAL_MIXEDICP_H
@@ -5,22 +5,44 @@
 
 class MultiUnitAbxICP: public LogNormalAbxICP
 {
+	// As LogNormalAbxICP, except that the constant acquisition parameter
+	// par[0][1] is fixed at 0 and each unit has its own, par[0][8+i] for
+	// the unit with System index i.
 private:
 
-	double acqRate(int unit, int onabx, double ncolabx, double ncol, double tot);
+	static const int first = 8;
 
-	Map *units;
+	// The per unit rates are not covered by the analytic gradient.
+	virtual bool hasGradient() const override {return false;}
 
-	int index(Object *u);
+	double acqRate(int unit, int onabx, int everabx, double ncolabx, double ncol, double tot);
+
+	inline int index(LocationState *ls) const
+	{
+		return first + ((Unit *) ls->getOwner())->getIndex();
+	}
 
 public:
 
 	MultiUnitAbxICP(List *u, int nst, int isDensity, int nmet);
-	virtual void setUnit(int i, Object *u, double value, int update, double prival, double priorn, double sig);
+
+	inline int nUnits() const
+	{
+		return n[0] - first;
+	}
+
+	virtual void setUnit(int i, double value, int update, double prival, double priorn);
+
+	virtual string header() const override;
 
 // Implement LogNormalICP.
 	virtual double logAcquisitionRate(double time, PatientState *p, LocationState *ls) override;
 	virtual double logAcquisitionGap(double u, double v, LocationState *ls) override;
-	virtual double* acquisitionRates(double time, PatientState *p, LocationState *ls) override;
+	virtual double* acquisitionRates(double time, PatientState *p, LocationState *ls, double *P) override;
+	virtual double acquisitionGapRate(LocationState *ls) override;
+
+// Implement Parameters.
+	// The per unit rates aren't in the gap table's columns.
+	virtual double logProbGaps(const GapTable &t) override {return Parameters::logProbGaps(t);}
 };
 #endif // ALUN_LOGNORMAL_MULTIUNITABXICP_H
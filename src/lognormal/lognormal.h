@@ -9,6 +9,8 @@
 	#include <sstream>
 	#include <exception>
     #include <stdexcept>
+    #include <array>
+    #include <map>
     #include <Rcpp.h>
 
     using namespace std;
@@ -105,6 +105,11 @@ double LinearAbxICP::logAcquisitionRate(double time, PatientState *p, LocationSt
 }
 
 double LinearAbxICP::logAcquisitionGap(double u, double v, LocationState *ls)
+{
+    return -timeExposure(acquisitionTrend(),u,v) * acquisitionGapRate(ls);
+}
+
+double LinearAbxICP::acquisitionGapRate(LocationState *ls)
 {
     AbxLocationState *as = (AbxLocationState *) ls;
     int nsus = as->getSusceptible();
@@ -114,24 +119,20 @@ double LinearAbxICP::logAcquisitionGap(double u, double v, LocationState *ls)
     int ntot = as->getTotal();
     int ncax = as->getAbxColonized();
 
-    if (abs(par[0][1]) < timepartol)
-    {
-        return -(v-u) * acqRate(nsus,ncur,neve,ncax,ncol,ntot,tOrigin);
-    }
-    else
-    {
-        return - (acqRate(nsus,ncur,neve,ncax,ncol,ntot,v)-acqRate(nsus,ncur,neve,ncax,ncol,ntot,u)) / par[0][1];
-    }
+    return acqRate(nsus,ncur,neve,ncax,ncol,ntot,tOrigin);
+}
+
+double LinearAbxICP::acquisitionTrend()
+{
+    return abs(par[0][1]) < timepartol ? 0 : par[0][1];
 }
 
-double* LinearAbxICP::acquisitionRates(double time, PatientState *p, LocationState *ls)
+double* LinearAbxICP::acquisitionRates(double time, PatientState *p, LocationState *ls, double *P)
 {
     AbxLocationState *as = (AbxLocationState *) ls;
     int onabx = as->onAbx((Patient *)p->getOwner());
     int everabx = as->everAbx((Patient *)p->getOwner());
 
-    double *P = new double[nstates];
-
     if (nstates == 2)
     {
         P[0] = acqRate(1,onabx,everabx,as->getAbxColonized(),as->getColonized(),as->getTotal(),time);
@@ -148,6 +149,133 @@ double* LinearAbxICP::acquisitionRates(double time, PatientState *p, LocationSta
     return P;
 }
 
+double LinearAbxICP::logProbGaps(const GapTable &t)
+{
+    unsigned int n = t.size();
+    const double *dt = t.dt.data();
+    const double *col = t.col.data();
+    const double *lat = t.lat.data();
+    const double *sus = t.sus.data();
+    const double *acol = t.abxcol.data();
+    const double *alat = t.abxlat.data();
+    const double *asus = t.abxsus.data();
+    const double *ecol = t.evercol.data();
+    const double *elat = t.everlat.data();
+    const double *esus = t.eversus.data();
+    const double *itot = t.invtot.data();
+
+    // getRate() is linear in the counts, so only the exposures of each
+    // abx group are needed.
+    double lnever = 0, lpast = 0, lnow = 0;
+    double cnever = 0, cpast = 0, cnow = 0;
+    for (unsigned int i=0; i<n; i++)
+    {
+        lnever += dt[i] * (lat[i]-elat[i]);
+        lpast += dt[i] * (elat[i]-alat[i]);
+        lnow += dt[i] * alat[i];
+        cnever += dt[i] * (col[i]-ecol[i]);
+        cpast += dt[i] * (ecol[i]-acol[i]);
+        cnow += dt[i] * acol[i];
+    }
+
+    double x = 0;
+    x -= epar[1][0] * (lnever + epar[1][2] * (lpast + epar[1][1] * lnow));
+    x -= epar[2][0] * (cnever + epar[2][2] * (cpast + epar[2][1] * cnow));
+
+    // Acquisition, as acquisitionGapRate().
+    double *e = epar[0];
+    gaprate.resize(n);
+    double *r = gaprate.data();
+    for (unsigned int i=0; i<n; i++)
+    {
+        double y = e[0] * ((e[3] * itot[i] + 1 - e[3]) * e[2] * ((col[i]-acol[i]) + e[4] * acol[i]) + 1 - e[2]);
+        double z = (sus[i]-esus[i]) + e[6] * ((esus[i]-asus[i]) + asus[i] * e[5]);
+        r[i] = y * z;
+    }
+
+    x -= gapExposure(t,r,acquisitionTrend());
+
+    return x;
+}
+
+bool LinearAbxICP::hasGradient() const
+{
+    return true;
+}
+
+void LinearAbxICP::rateGradient(int i, int risk, int ever, int cur, double w, double **g)
+{
+    double y = ever-cur + epar[i][1] * cur;
+    g[i][0] += w * getRate(i,risk,ever,cur);
+    g[i][1] += w * epar[i][0] * epar[i][2] * epar[i][1] * cur;
+    g[i][2] += w * epar[i][0] * epar[i][2] * y;
+}
+
+double LinearAbxICP::acqGradient(int nsus, int onabx, int everabx, int ncolabx, int ncol, int tot, double w, double **g)
+{
+    double *e = epar[0];
+
+    double a = (tot > 0 ? e[3]/tot : 0) + 1 - e[3];
+    double b = (ncol-ncolabx) + e[4]*ncolabx;
+    double y = e[0] * (a * e[2] * b + 1 - e[2]);
+    double z = (nsus-everabx) + e[6] * ( (everabx-onabx) + onabx * e[5]);
+    double x = y * z;
+
+    // par[0][2] and par[0][3] are on the logit scale, the rest on the log.
+    g[0][0] += w * x;
+    g[0][2] += w * e[0] * (a*b - 1) * e[2] * (1-e[2]) * z;
+    g[0][3] += w * e[0] * e[2] * b * e[3] * (1-e[3]) * ((tot > 0 ? 1.0/tot : 0) - 1) * z;
+    g[0][4] += w * e[0] * a * e[2] * e[4] * ncolabx * z;
+    g[0][5] += w * y * e[6] * onabx * e[5];
+    g[0][6] += w * y * e[6] * ( (everabx-onabx) + onabx * e[5]);
+
+    return x;
+}
+
+void LinearAbxICP::eventGradient(PatternStats &es, double **g)
+{
+    HistoryLink *h = es.link;
+    Patient *pat = (Patient *) h->pPrev()->getPState()->getOwner();
+    AbxLocationState *as = (AbxLocationState *) h->uPrev()->getUState();
+    int onabx = as->onAbx(pat);
+    int everabx = as->everAbx(pat);
+
+    switch(h->getEvent()->getType())
+    {
+    case progression:
+        rateGradient(1,1,everabx,onabx,es.n/getRate(1,1,everabx,onabx),g);
+        break;
+
+    case clearance:
+        rateGradient(2,1,everabx,onabx,es.n/getRate(2,1,everabx,onabx),g);
+        break;
+
+    case acquisition:
+        {
+            double x = acqRate(1,onabx,everabx,as->getAbxColonized(),as->getColonized(),as->getTotal(),tOrigin);
+            acqGradient(1,onabx,everabx,as->getAbxColonized(),as->getColonized(),as->getTotal(),es.n/x,g);
+            g[0][1] += es.sumt;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void LinearAbxICP::gapGradient(PatternStats &gs, double gaptrend, double **g)
+{
+    AbxLocationState *as = (AbxLocationState *) gs.link->uPrev()->getUState();
+
+    rateGradient(1,as->getLatent(),as->getEverAbxLatent(),as->getAbxLatent(),-gs.dt,g);
+    rateGradient(2,as->getColonized(),as->getEverAbxColonized(),as->getAbxColonized(),-gs.dt,g);
+
+    double e = exposure(gs,gaptrend);
+    double x = acqGradient(as->getSusceptible(),as->getAbxSusceptible(),as->getEverAbxSusceptible(),
+        as->getAbxColonized(),as->getColonized(),as->getTotal(),-e,g);
+    g[0][1] -= x * exposureGradient(gs,gaptrend);
+}
+
 double LinearAbxICP::unTransform(int i, int j)
 {
     if (i == 0 && (j == 2 || j == 3))
@@ -155,6 +283,13 @@ double LinearAbxICP::unTransform(int i, int j)
     return exp(par[i][j]);
 }
 
+double LinearAbxICP::transform(int i, int j, double x)
+{
+    if (i == 0 && (j == 2 || j == 3))
+        return logit(x);
+    return log(x);
+}
+
 void LinearAbxICP::set(int i, int j, double value, int update, double prival, double priorn)
 {
     if (i == 0)
@@ -7,6 +7,23 @@ namespace lognormal{
 
 LinearAbxICP2::LinearAbxICP2(int nst, int nmet, int nacqpar) : LogNormalICP(nst,nacqpar,3,3,nmet)
 {
+    // Same names as header(), so that paramNames() matches getValues().
+    const char *acq[] = {"LABX.base", "LABX.time", "LABX.dens", "LABX.freq", "LABX.colabx", "LABX.susabx", "LABX.susever"};
+    for (int j=0; j<nacqpar; j++)
+    {
+        if (j < 7)
+            pnames[0][j] = acq[j];
+        else
+            pnames[0][j] = "LABX.acq" + std::to_string(j);
+    }
+
+    pnames[1][0] = "LABX.pro";
+    pnames[1][1] = "LABX.proAbx";
+    pnames[1][2] = "LABX.proEver";
+
+    pnames[2][0] = "LABX.clr";
+    pnames[2][1] = "LABX.clrAbx";
+    pnames[2][2] = "LABX.clrEver";
 }
 
 string LinearAbxICP2::header() const
@@ -85,7 +102,11 @@ double LinearAbxICP2::logAcquisitionRate(double time, PatientState *p, LocationS
 
 double LinearAbxICP2::logAcquisitionGap(double u, double v, LocationState *ls)
 {
-    static constexpr double timepartol = 0.000000001;
+    return -timeExposure(acquisitionTrend(),u,v) * acquisitionGapRate(ls);
+}
+
+double LinearAbxICP2::acquisitionGapRate(LocationState *ls)
+{
     AbxLocationState *as = (AbxLocationState *) ls;
     int nsus = as->getSusceptible();
     int neve = as->getEverAbxSusceptible();
@@ -94,24 +115,20 @@ double LinearAbxICP2::logAcquisitionGap(double u, double v, LocationState *ls)
     int ntot = as->getTotal();
     int ncax = as->getAbxColonized();
 
-    if (abs(par[0][1]) < timepartol)
-    {
-        return -(v-u) * acqRate(nsus,ncur,neve,ncax,ncol,ntot,tOrigin);
-    }
-    else
-    {
-        return - (acqRate(nsus,ncur,neve,ncax,ncol,ntot,v)-acqRate(nsus,ncur,neve,ncax,ncol,ntot,u)) / par[0][1];
-    }
+    return acqRate(nsus,ncur,neve,ncax,ncol,ntot,tOrigin);
 }
 
-double* LinearAbxICP2::acquisitionRates(double time, PatientState *p, LocationState *ls)
+double LinearAbxICP2::acquisitionTrend()
+{
+    return abs(par[0][1]) < timepartol ? 0 : par[0][1];
+}
+
+double* LinearAbxICP2::acquisitionRates(double time, PatientState *p, LocationState *ls, double *P)
 {
     AbxLocationState *as = (AbxLocationState *) ls;
     int onabx = as->onAbx((Patient *)p->getOwner());
     int everabx = as->everAbx((Patient *)p->getOwner());
 
-    double *P = new double[nstates];
-
     if (nstates == 2)
     {
         P[0] = acqRate(1,onabx,everabx,as->getAbxColonized(),as->getColonized(),as->getTotal(),time);
@@ -161,7 +161,9 @@ LogNormalAbxICP::LogNormalAbxICP(int nst, int isDensity, int nmet, int cap) : Lo
     setParameterNames();
 }
 
-double LogNormalAbxICP::timePar(){return par[0][0];}
+double LogNormalAbxICP::timePar(){return par[0][timeIndex()];}
+
+int LogNormalAbxICP::timeIndex() const {return 0;}
 
 double LogNormalAbxICP::logProgressionRate(double time, PatientState *p, LocationState *s)
 {
@@ -207,7 +209,11 @@ double LogNormalAbxICP::logAcquisitionRate(double time, PatientState *p, Locatio
 
 double LogNormalAbxICP::logAcquisitionGap(double u, double v, LocationState *ls)
 {
-    double t = (abs(timePar()) < 0.0000001 ? (v-u) : (exp(timePar()*(v-tOrigin)) - exp(timePar()*(u-tOrigin))) / timePar() ) ;
+    return -timeExposure(acquisitionGapTrend(),u,v) * acquisitionGapRate(ls);
+}
+
+double LogNormalAbxICP::acquisitionGapRate(LocationState *ls)
+{
     double x = 0;
 
     AbxLocationState *as = (AbxLocationState *) ls;
@@ -225,17 +231,25 @@ double LogNormalAbxICP::logAcquisitionGap(double u, double v, LocationState *ls)
             x += icx * acqRate(tOrigin,1,1,as->getAbxColonized(),as->getColonized(),as->getTotal());
     }
 
-    return -t*x;
+    return x;
+}
+
+double LogNormalAbxICP::acquisitionTrend()
+{
+    return logbeta_acq_time();
+}
+
+double LogNormalAbxICP::acquisitionGapTrend()
+{
+    return abs(timePar()) < 0.0000001 ? 0 : timePar();
 }
 
-double* LogNormalAbxICP::acquisitionRates(double time, PatientState *p, LocationState *ls)
+double* LogNormalAbxICP::acquisitionRates(double time, PatientState *p, LocationState *ls, double *P)
 {
     AbxLocationState *as = (AbxLocationState *) ls;
     int onabx = as->onAbx((Patient *)p->getOwner());
     int everabx = as->everAbx((Patient *)p->getOwner());
 
-    double *P = new double[nstates];
-
     if (nstates == 2)
     {
         P[0] = acqRate(time,onabx,everabx,as->getAbxColonized(),as->getColonized(),as->getTotal());
@@ -252,25 +266,158 @@ double* LogNormalAbxICP::acquisitionRates(double time, PatientState *p, Location
     return P;
 }
 
-std::vector<std::string> LogNormalAbxICP::paramNames() const {
-    std::vector<std::string> names;
-    names[0] = "LNAX.time";
-    names[1] = "LNAX.base";
-    names[2] = "LNAX.ltot";
-    names[3] = "LNAX.lcol";
-    names[4] = "LNAX.col";
-    names[5] = "LNAX.colabx";
-    names[6] = "LNAX.susabx";
-    names[7] = "LNAX.susever";
-
-    names[8] = "LNAX.pro";
-    names[9] = "LNAX.proAbx";
-    names[10] = "LNAX.proEver";
-
-    names[11] = "LNAX.clr";
-    names[12] = "LNAX.clrAbx";
-    names[13] = "LNAX.clrEver";
-    return names;
+double LogNormalAbxICP::logProbGaps(const GapTable &t)
+{
+    unsigned int n = t.size();
+    const double *dt = t.dt.data();
+    const double *col = t.col.data();
+    const double *lat = t.lat.data();
+    const double *sus = t.sus.data();
+    const double *acol = t.abxcol.data();
+    const double *alat = t.abxlat.data();
+    const double *asus = t.abxsus.data();
+    const double *ecol = t.evercol.data();
+    const double *elat = t.everlat.data();
+    const double *esus = t.eversus.data();
+    const double *ltot = t.logtot.data();
+    const double *lcol = t.logcol.data();
+    const double *hcol = t.hascol.data();
+
+    // Progression and clearance are linear in the counts, so only the
+    // exposures of each abx group are needed.
+    double lnever = 0, lpast = 0, lnow = 0;
+    double cnever = 0, cpast = 0, cnow = 0;
+    for (unsigned int i=0; i<n; i++)
+    {
+        lnever += dt[i] * (lat[i]-elat[i]);
+        lpast += dt[i] * (elat[i]-alat[i]);
+        lnow += dt[i] * alat[i];
+        cnever += dt[i] * (col[i]-ecol[i]);
+        cpast += dt[i] * (ecol[i]-acol[i]);
+        cnow += dt[i] * acol[i];
+    }
+
+    double x = 0;
+    x -= progRate(0,0) * lnever + progRate(0,1) * lpast + progRate(1,1) * lnow;
+    x -= clearRate(0,0) * cnever + clearRate(0,1) * cpast + clearRate(1,1) * cnow;
+
+    // Acquisition, as acquisitionGapRate() with the abx effects taken out
+    // of the exponent. Gaps with no colonized patients are masked out.
+    double b0 = logbeta_acq_constant();
+    double btot = logbeta_acq_tot_inpat();
+    double blcol = logbeta_acq_log_col();
+    double bcol = logbeta_acq_col();
+    double bacol = logbeta_acq_abx_col();
+    double past = exp(logbeta_acq_everabx());
+    double now = exp(logbeta_acq_onabx() + logbeta_acq_everabx());
+
+    gaprate.resize(n);
+    double *r = gaprate.data();
+    for (unsigned int i=0; i<n; i++)
+    {
+        double w = (sus[i]-esus[i]) + past * (esus[i]-asus[i]) + now * asus[i];
+        r[i] = hcol[i] * w * exp(b0 + btot * ltot[i] + blcol * lcol[i] + bcol * col[i] + bacol * acol[i]);
+    }
+
+    x -= gapExposure(t,r,acquisitionGapTrend());
+
+    return x;
+}
+
+bool LogNormalAbxICP::hasGradient() const
+{
+    return true;
+}
+
+void LogNormalAbxICP::eventGradient(PatternStats &es, double **g)
+{
+    HistoryLink *h = es.link;
+    Patient *pat = (Patient *) h->pPrev()->getPState()->getOwner();
+    AbxLocationState *as = (AbxLocationState *) h->uPrev()->getUState();
+    int onabx = as->onAbx(pat);
+    int everabx = as->everAbx(pat);
+    int ncol = as->getColonized();
+
+    switch(h->getEvent()->getType())
+    {
+    case progression:
+        g[1][0] += es.n;
+        g[1][1] += es.n * onabx;
+        g[1][2] += es.n * everabx;
+        break;
+
+    case clearance:
+        g[2][0] += es.n;
+        g[2][1] += es.n * onabx;
+        g[2][2] += es.n * everabx;
+        break;
+
+    case acquisition:
+        // par[0][0] is both the constant and the trend in logAcqRate().
+        g[0][0] += es.n + es.sumt;
+        if (ncol > 0)
+        {
+            g[0][2] += es.n * log((double) as->getTotal());
+            g[0][3] += es.n * log((double) ncol);
+        }
+        g[0][4] += es.n * ncol;
+        g[0][5] += es.n * as->getAbxColonized();
+        g[0][6] += es.n * onabx;
+        g[0][7] += es.n * everabx;
+        break;
+
+    default:
+        break;
+    }
+}
+
+void LogNormalAbxICP::gapGradient(PatternStats &gs, double gaptrend, double **g)
+{
+    AbxLocationState *as = (AbxLocationState *) gs.link->uPrev()->getUState();
+
+    double nx = progRate(0,0) * as->getNeverAbxLatent();
+    double px = progRate(0,1) * (as->getEverAbxLatent() - as->getAbxLatent());
+    double cx = progRate(1,1) * as->getAbxLatent();
+    g[1][0] -= gs.dt * (nx + px + cx);
+    g[1][1] -= gs.dt * cx;
+    g[1][2] -= gs.dt * (px + cx);
+
+    nx = clearRate(0,0) * as->getNeverAbxColonized();
+    px = clearRate(0,1) * (as->getEverAbxColonized() - as->getAbxColonized());
+    cx = clearRate(1,1) * as->getAbxColonized();
+    g[2][0] -= gs.dt * (nx + px + cx);
+    g[2][1] -= gs.dt * cx;
+    g[2][2] -= gs.dt * (px + cx);
+
+    // The acquisition term is -exposure * sum of count * rate, with each
+    // rate log linear in par[0].
+    int ncol = as->getColonized();
+    if (as->getSusceptible() <= 0 || ncol <= 0)
+        return;
+
+    int tot = as->getTotal();
+    int ncolabx = as->getAbxColonized();
+    double rn = as->getNeverAbxSusceptible() * acqRate(tOrigin,0,0,ncolabx,ncol,tot);
+    double rp = (as->getEverAbxSusceptible() - as->getAbxSusceptible()) * acqRate(tOrigin,0,1,ncolabx,ncol,tot);
+    double rc = as->getAbxSusceptible() * acqRate(tOrigin,1,1,ncolabx,ncol,tot);
+    double rate = rn + rp + rc;
+
+    double e = exposure(gs,gaptrend);
+    g[0][0] -= e * rate;
+    g[0][2] -= e * rate * log((double) tot);
+    g[0][3] -= e * rate * log((double) ncol);
+    g[0][4] -= e * rate * ncol;
+    g[0][5] -= e * rate * ncolabx;
+    g[0][6] -= e * rc;
+    g[0][7] -= e * (rp + rc);
+
+    g[0][timeIndex()] -= rate * exposureGradient(gs,gaptrend);
+}
+
+std::vector<std::string> LogNormalAbxICP::paramNames() const
+{
+    // The names are set in pnames by setParameterNames(), or by subclasses.
+    return LogNormalICP::paramNames();
 }
 
 } // namespace lognormal
@@ -25,7 +25,6 @@ LogNormalICP::LogNormalICP(int k, int napar, int nppar, int ncpar, int nmet) : I
 
     nmetro = nmet;
 
-    m = new Map();
     initCounts();
 
     n = cleanAllocInt(ns);
@@ -41,6 +40,13 @@ LogNormalICP::LogNormalICP(int k, int napar, int nppar, int ncpar, int nmet) : I
     pristdev = new double*[ns];
     doit = new int*[ns];
     sigmaprop = new double*[ns];
+    nproposed = new int*[ns];
+    naccepted = new int*[ns];
+    nadapt = 0;
+    adapting = false;
+    block = false;
+    hmc = false;
+    hmcstep = 0.5;
 
     for (int i=0; i<ns; i++)
     {
@@ -54,13 +60,23 @@ LogNormalICP::LogNormalICP(int k, int napar, int nppar, int ncpar, int nmet) : I
         sigmaprop[i] = cleanAlloc(n[i]);
         for (int j=0; j<n[i]; j++)
             sigmaprop[i][j] = 0.1;
+        nproposed[i] = cleanAllocInt(n[i]);
+        naccepted[i] = cleanAllocInt(n[i]);
+    }
+
+    blockscale = cleanAlloc(ns);
+    nblock = cleanAlloc(ns);
+    blockmean = new double*[ns];
+    blockss = new double**[ns];
+    for (int i=0; i<ns; i++)
+    {
+        blockmean[i] = cleanAlloc(n[i]);
+        blockss[i] = cleanAlloc(n[i],n[i]);
     }
 }
 
 LogNormalICP::~LogNormalICP()
 {
-    delete [] n;
-
     for (int i=0; i<ns; i++)
     {
         delete [] par[i];
@@ -69,6 +85,10 @@ LogNormalICP::~LogNormalICP()
         delete [] pristdev[i];
         delete [] doit[i];
         delete [] sigmaprop[i];
+        delete [] nproposed[i];
+        delete [] naccepted[i];
+        delete [] blockmean[i];
+        cleanFree(&blockss[i],n[i]);
     }
 
     delete [] par;
@@ -77,7 +97,13 @@ LogNormalICP::~LogNormalICP()
     delete [] pristdev;
     delete [] doit;
     delete [] sigmaprop;
-    delete m;
+    delete [] nproposed;
+    delete [] naccepted;
+    delete [] blockscale;
+    delete [] nblock;
+    delete [] blockmean;
+    delete [] blockss;
+    delete [] n;
 }
 
 int LogNormalICP::nParam2(int i) const
@@ -100,6 +126,46 @@ double LogNormalICP::getTimeOrigin()
     return tOrigin;
 }
 
+double LogNormalICP::acquisitionTrend()
+{
+    return 0;
+}
+
+double LogNormalICP::acquisitionGapTrend()
+{
+    return acquisitionTrend();
+}
+
+/// Integral of exp(trend * (t-tOrigin)) over the interval (t0,t1).
+double LogNormalICP::timeExposure(double trend, double t0, double t1)
+{
+    if (trend == 0)
+        return t1-t0;
+    return (exp(trend*(t1-tOrigin)) - exp(trend*(t0-tOrigin))) / trend;
+}
+
+double LogNormalICP::gapExposure(const GapTable &t, const double *rate, double trend)
+{
+    const double *dt = t.dt.data();
+    const double *t0 = t.t0.data();
+    const double *t1 = t.t1.data();
+    unsigned int n = t.size();
+
+    double x = 0;
+    if (trend == 0)
+    {
+        for (unsigned int i=0; i<n; i++)
+            x += rate[i] * dt[i];
+    }
+    else
+    {
+        for (unsigned int i=0; i<n; i++)
+            x += rate[i] * (exp(trend*(t1[i]-tOrigin)) - exp(trend*(t0[i]-tOrigin)));
+        x /= trend;
+    }
+    return x;
+}
+
 // Personal accessors.
 
 void LogNormalICP::set(int i, int j, double value, int update, double prival, double priorn)
@@ -112,6 +178,11 @@ double LogNormalICP::unTransform(int i, int j)
     return exp(par[i][j]);
 }
 
+double LogNormalICP::transform(int i, int j, double x)
+{
+    return log(x);
+}
+
 void LogNormalICP::setWithLogTransform(int i, int j, double value, int update, double prival, double priorn, double sig)
 {
     // For rate parameters.
@@ -236,6 +307,115 @@ std::vector<std::string> LogNormalICP::paramNames() const
     return res;
 }
 
+void LogNormalICP::getAcceptance(std::vector<int> &proposed, std::vector<int> &accepted) const
+{
+    proposed.clear();
+    accepted.clear();
+    for (int i=0; i<ns; i++)
+    {
+        if (i == 1 && nstates != 3)
+            continue;
+
+        for (int j=0; j<n[i]; j++)
+        {
+            proposed.push_back(nproposed[i][j]);
+            accepted.push_back(naccepted[i][j]);
+        }
+    }
+}
+
+void LogNormalICP::clearAcceptance()
+{
+    for (int i=0; i<ns; i++)
+        for (int j=0; j<n[i]; j++)
+        {
+            nproposed[i][j] = 0;
+            naccepted[i][j] = 0;
+        }
+}
+
+std::vector<double> LogNormalICP::getState() const
+{
+    // The log scale values, so that setState() gives back exactly the
+    // same transformed ones, then the proposal scales, the statistics
+    // for the joint proposals and the HMC step size.
+    std::vector<double> x;
+    for (int i=0; i<ns; i++)
+        for (int j=0; j<n[i]; j++)
+            x.push_back(par[i][j]);
+    for (int i=0; i<ns; i++)
+        for (int j=0; j<n[i]; j++)
+            x.push_back(sigmaprop[i][j]);
+    x.push_back(nadapt);
+    for (int i=0; i<ns; i++)
+    {
+        x.push_back(blockscale[i]);
+        x.push_back(nblock[i]);
+        for (int j=0; j<n[i]; j++)
+            x.push_back(blockmean[i][j]);
+        for (int j=0; j<n[i]; j++)
+            for (int k=0; k<n[i]; k++)
+                x.push_back(blockss[i][j][k]);
+    }
+    x.push_back(hmcstep);
+    return x;
+}
+
+void LogNormalICP::setState(const std::vector<double> &x)
+{
+    size_t k = 2;
+    for (int i=0; i<ns; i++)
+        k += 2 + 3*n[i] + n[i]*n[i];
+    if (x.size() != k)
+        throw std::runtime_error("Wrong number of values for " + className() + " state");
+
+    k = 0;
+    for (int i=0; i<ns; i++)
+        for (int j=0; j<n[i]; j++)
+            setNormal(i,j,x[k++]);
+    for (int i=0; i<ns; i++)
+        for (int j=0; j<n[i]; j++)
+            sigmaprop[i][j] = x[k++];
+    nadapt = x[k++];
+    for (int i=0; i<ns; i++)
+    {
+        blockscale[i] = x[k++];
+        nblock[i] = x[k++];
+        for (int j=0; j<n[i]; j++)
+            blockmean[i][j] = x[k++];
+        for (int j=0; j<n[i]; j++)
+            for (int l=0; l<n[i]; l++)
+                blockss[i][j][l] = x[k++];
+    }
+    hmcstep = x[k];
+}
+
+void LogNormalICP::setValues(const std::vector<double> &x)
+{
+    // The same order as getValues(), which leaves out the progression
+    // parameters unless there are three states.
+    size_t k = 0;
+    for (int i=0; i<ns; i++)
+        if (i != 1 || nstates == 3)
+            k += n[i];
+    if (x.size() != k)
+        throw std::runtime_error("Wrong number of values for " + className());
+
+    k = 0;
+    for (int i=0; i<ns; i++)
+    {
+        if (i == 1 && nstates != 3)
+            continue;
+        for (int j=0; j<n[i]; j++)
+            setNormal(i,j,transform(i,j,x[k++]));
+    }
+}
+
+void LogNormalICP::setAdapting(bool a)
+{
+    adapting = a;
+}
+
 void LogNormalICP::write (ostream &os)
 {
     char *buffer = new char[100];
@@ -303,9 +483,11 @@ double LogNormalICP::eventRate(double time, EventCode c, PatientState *p, Locati
 ///
 ///
 ///
-double** LogNormalICP::rateMatrix(double time, PatientState *p, LocationState *u)
+double** LogNormalICP::rateMatrix(double time, PatientState *p, LocationState *u, double **Q)
 {
-    double **Q = cleanAlloc(nstates,nstates);
+    for (int i=0; i<nstates; i++)
+        for (int j=0; j<nstates; j++)
+            Q[i][j] = 0;
 
     if (nstates == 2)
     {
@@ -363,16 +545,147 @@ double LogNormalICP::logProbGap(HistoryLink *g, HistoryLink *h)
 
 void LogNormalICP::initCounts()
 {
-    m->clear();
+    events.clear();
+    gaps.clear();
 }
 
 void LogNormalICP::count(HistoryLink *h)
 {
 }
 
+void LogNormalICP::setPattern(Pattern &x, int type, Patient *p, LocationState *s)
+{
+    x.fill(0);
+    x[0] = type;
+    x[1] = (int) s->getOwner()->hash();
+    x[4] = s->getTotal();
+    x[5] = s->getColonized();
+    x[6] = s->getLatent();
+    x[7] = s->getSusceptible();
+
+    AbxLocationState *as = dynamic_cast<AbxLocationState *>(s);
+    if (as != 0)
+    {
+        if (p != 0)
+        {
+            x[2] = as->onAbx(p);
+            x[3] = as->everAbx(p);
+        }
+        x[8] = as->getAbxColonized();
+        x[9] = as->getEverAbxColonized();
+        x[10] = as->getAbxLatent();
+        x[11] = as->getEverAbxLatent();
+        x[12] = as->getAbxTotal();
+        x[13] = as->getEverAbxTotal();
+    }
+}
+
 void LogNormalICP::countGap(HistoryLink *g, HistoryLink *h)
 {
-    m->put(h,g);
+    countGap(g,h,events,gaps);
+}
+
+void LogNormalICP::countGap(HistoryLink *g, HistoryLink *h, std::map<Pattern,PatternStats> &ev, std::map<Pattern,PatternStats> &gp)
+{
+    LocationState *s = h->uPrev()->getUState();
+    double t0 = g->getEvent()->getTime();
+    double t1 = h->getEvent()->getTime();
+
+    Pattern x;
+    setPattern(x,-1,0,s);
+    auto gi = gp.emplace(x,PatternStats());
+    PatternStats &gs = gi.first->second;
+    if (gi.second)
+    {
+        gs.link = h;
+        gs.n = 0;
+        gs.sumt = 0;
+        gs.dt = 0;
+        gs.trend = 0;
+        gs.expo = 0;
+    }
+    gs.dt += t1-t0;
+    gs.u.push_back(t0);
+    gs.v.push_back(t1);
+
+    switch(h->getEvent()->getType())
+    {
+    case progression:
+    case clearance:
+    case acquisition:
+        break;
+    default:
+        return;
+    }
+
+    setPattern(x,h->getEvent()->getType(),(Patient *)h->pPrev()->getPState()->getOwner(),s);
+    auto ei = ev.emplace(x,PatternStats());
+    PatternStats &es = ei.first->second;
+    if (ei.second)
+    {
+        es.link = h;
+        es.n = 0;
+        es.sumt = 0;
+        es.dt = 0;
+        es.trend = 0;
+        es.expo = 0;
+    }
+    es.n++;
+    es.sumt += t1-tOrigin;
+}
+
+Parameters::Counts *LogNormalICP::newCounts()
+{
+    return new PatternCounts();
+}
+
+void LogNormalICP::countGapInto(HistoryLink *g, HistoryLink *h, Counts *c)
+{
+    PatternCounts *pc = (PatternCounts *) c;
+    countGap(g,h,pc->events,pc->gaps);
+}
+
+void LogNormalICP::addCounts(Counts *c)
+{
+    PatternCounts *pc = (PatternCounts *) c;
+    addStats(events,pc->events);
+    addStats(gaps,pc->gaps);
+}
+
+void LogNormalICP::addStats(std::map<Pattern,PatternStats> &to, std::map<Pattern,PatternStats> &from)
+{
+    for (auto &f : from)
+    {
+        auto ti = to.emplace(f.first,f.second);
+        if (ti.second)
+            continue;
+        PatternStats &t = ti.first->second;
+        t.n += f.second.n;
+        t.sumt += f.second.sumt;
+        t.dt += f.second.dt;
+        t.u.insert(t.u.end(),f.second.u.begin(),f.second.u.end());
+        t.v.insert(t.v.end(),f.second.v.begin(),f.second.v.end());
+        t.trend = 0;
+        t.expo = 0;
+    }
+}
+
+/// Total exposure of the gaps in a pattern to an acquisition rate with the given trend.
+/// This only needs recomputing when the trend parameter itself changes.
+double LogNormalICP::exposure(PatternStats &x, double trend)
+{
+    if (trend == 0)
+        return x.dt;
+
+    if (trend != x.trend)
+    {
+        x.expo = 0;
+        for (unsigned int i=0; i<x.u.size(); i++)
+            x.expo += timeExposure(trend,x.u[i],x.v[i]);
+        x.trend = trend;
+    }
+
+    return x.expo;
 }
 
 double LogNormalICP::logpost(Random *r, int max)
@@ -385,23 +698,77 @@ double LogNormalICP::logpost(Random *r, int max)
                 if (doit[i][j])
                     x += r->logdnorm(par[i][j],primean[i][j],pristdev[i][j]);
 
-    for (m->init(); m->hasNext(); )
+    double trend = acquisitionTrend();
+
+    for (auto &e : events)
+    {
+        PatternStats &es = e.second;
+        HistoryLink *h = es.link;
+        PatientState *p = h->pPrev()->getPState();
+        LocationState *s = h->uPrev()->getUState();
+
+        switch(h->getEvent()->getType())
+        {
+        case progression:
+            x += es.n * logProgressionRate(tOrigin,p,s);
+            break;
+        case clearance:
+            x += es.n * logClearanceRate(tOrigin,p,s);
+            break;
+        case acquisition:
+            x += es.n * logAcquisitionRate(tOrigin,p,s) + trend * es.sumt;
+            break;
+        default:
+            break;
+        }
+    }
+
+    double gaptrend = acquisitionGapTrend();
+
+    for (auto &g : gaps)
     {
-        HistoryLink *h = (HistoryLink *) m->next();
-        HistoryLink *g = (HistoryLink *) m->get(h);
-        x += logProb(h) + logProbGap(g,h);
+        PatternStats &gs = g.second;
+        LocationState *s = gs.link->uPrev()->getUState();
+
+        x += logProgressionGap(0,gs.dt,s);
+        x += logClearanceGap(0,gs.dt,s);
+        x -= exposure(gs,gaptrend) * acquisitionGapRate(s);
     }
 
     return x;
 }
 
+double LogNormalICP::countedLogLikelihood()
+{
+    return logpost(0,1);
+}
+
 void LogNormalICP::update(Random *r, bool max)
 {
     double oldlogpost = logpost(r,max);
 
     for (int its = 0; its < nmetro; its++)
     {
+        if (adapting && !max)
+            nadapt++;
+
+        if (hmc && !max)
+        {
+            oldlogpost = updateHMC(r,oldlogpost);
+            continue;
+        }
+
         for (int i=0; i<ns; i++)
+        {
+            int d = 0;
+            for (int j=0; j<n[i]; j++)
+                d += doit[i][j] != 0;
+            if (block && d > 1)
+            {
+                oldlogpost = updateBlock(r,max,i,oldlogpost);
+                continue;
+            }
+
             for (int j=0; j<n[i]; j++)
             {
                 if (doit[i][j])
@@ -410,10 +777,17 @@ void LogNormalICP::update(Random *r, bool max)
                     double newone = oldone + r->rnorm(0,sigmaprop[i][j]);
                     setNormal(i,j,newone);
                     double newlogpost = logpost(r,max);
+                    nproposed[i][j]++;
+
+                    // One parameter at a time, so aim for the usual one
+                    // dimensional rate.
+                    if (adapting && !max)
+                        sigmaprop[i][j] = adaptScale(sigmaprop[i][j], newlogpost - oldlogpost, 0.44, nadapt);
 
                     if ( (max ? 0 : log(r->runif()) ) <= newlogpost - oldlogpost)
                     {
                         oldlogpost = newlogpost;
+                        naccepted[i][j]++;
                     }
                     else
                     {
@@ -421,6 +795,344 @@ void LogNormalICP::update(Random *r, bool max)
                     }
                 }
             }
+        }
+    }
+}
+
+void LogNormalICP::blockFactor(int i, double **L)
+{
+    int m = n[i];
+
+    // The covariance learned while adapting, once there is enough of the
+    // chain to go on, with a little of the one at a time proposal added to
+    // keep it positive definite. Before that, or if the learned one still
+    // can't be factorized, the one at a time proposal.
+    int d = 0;
+    for (int j=0; j<m; j++)
+        d += doit[i][j] != 0;
+
+    for (int learned = nblock[i] > 2*d; learned >= 0; learned--)
+    {
+        for (int j=0; j<m; j++)
+            for (int k=0; k<m; k++)
+            {
+                if (!doit[i][j] || !doit[i][k])
+                    L[j][k] = j == k ? 1 : 0;
+                else if (learned)
+                    L[j][k] = blockss[i][j][k] / (nblock[i]-1) + (j == k ? 1e-4 * sigmaprop[i][j] * sigmaprop[i][j] : 0);
+                else
+                    L[j][k] = j == k ? sigmaprop[i][j] * sigmaprop[i][j] : 0;
+            }
+
+        // In place Cholesky factorization into the lower triangle.
+        bool ok = true;
+        for (int j=0; j<m && ok; j++)
+        {
+            for (int k=0; k<=j; k++)
+            {
+                double s = L[j][k];
+                for (int l=0; l<k; l++)
+                    s -= L[j][l] * L[k][l];
+
+                if (j == k)
+                {
+                    ok = s > 0;
+                    L[j][j] = ok ? sqrt(s) : 0;
+                }
+                else
+                {
+                    L[j][k] = s / L[k][k];
+                }
+            }
+            for (int k=j+1; k<m; k++)
+                L[j][k] = 0;
+        }
+
+        if (ok)
+            return;
+    }
+
+    throw std::runtime_error("Proposal scales must be positive");
+}
+
+double LogNormalICP::updateBlock(Random *r, bool max, int i, double oldlogpost)
+{
+    int m = n[i];
+    int d = 0;
+    for (int j=0; j<m; j++)
+        d += doit[i][j] != 0;
+
+    // The optimal scale for d parameters with a proposal shaped like the
+    // posterior.
+    if (blockscale[i] <= 0)
+        blockscale[i] = 2.38 / sqrt((double) d);
+
+    double **L = cleanAlloc(m,m);
+    blockFactor(i,L);
+
+    double *oldone = new double[m];
+    double *z = new double[m];
+    for (int j=0; j<m; j++)
+    {
+        oldone[j] = par[i][j];
+        z[j] = doit[i][j] ? r->rnorm(0,1) : 0;
+    }
+
+    for (int j=0; j<m; j++)
+    {
+        if (!doit[i][j])
+            continue;
+        double x = 0;
+        for (int k=0; k<=j; k++)
+            x += L[j][k] * z[k];
+        setNormal(i,j,oldone[j] + blockscale[i] * x);
+        nproposed[i][j]++;
     }
+
+    double newlogpost = logpost(r,max);
+
+    // Several parameters move at once, so aim for the usual many
+    // dimensional rate.
+    if (adapting && !max)
+        blockscale[i] = adaptScale(blockscale[i], newlogpost - oldlogpost, 0.234, nadapt);
+
+    if ( (max ? 0 : log(r->runif()) ) <= newlogpost - oldlogpost)
+    {
+        oldlogpost = newlogpost;
+        for (int j=0; j<m; j++)
+            if (doit[i][j])
+                naccepted[i][j]++;
+    }
+    else
+    {
+        for (int j=0; j<m; j++)
+            if (doit[i][j])
+                setNormal(i,j,oldone[j]);
+    }
+
+    // Welford's update of the running mean and sums of squares and
+    // products of the row.
+    if (adapting && !max)
+    {
+        nblock[i]++;
+        for (int j=0; j<m; j++)
+        {
+            z[j] = par[i][j] - blockmean[i][j];
+            blockmean[i][j] += z[j] / nblock[i];
+        }
+        for (int j=0; j<m; j++)
+            for (int k=0; k<m; k++)
+                blockss[i][j][k] += z[j] * (par[i][k] - blockmean[i][k]);
+    }
+
+    delete [] oldone;
+    delete [] z;
+    cleanFree(&L,m);
+
+    return oldlogpost;
+}
+
+bool LogNormalICP::hasGradient() const
+{
+    return false;
+}
+
+void LogNormalICP::eventGradient(PatternStats &es, double **g)
+{
+}
+
+void LogNormalICP::gapGradient(PatternStats &gs, double gaptrend, double **g)
+{
+}
+
+double LogNormalICP::exposureGradient(PatternStats &x, double trend)
+{
+    double d = 0;
+    for (unsigned int i=0; i<x.u.size(); i++)
+    {
+        double u = x.u[i] - tOrigin;
+        double v = x.v[i] - tOrigin;
+        // Near 0 the difference quotient cancels, so use its series.
+        if (fabs(trend*u) < 1e-3 && fabs(trend*v) < 1e-3)
+            d += (v*v - u*u) / 2 + trend * (v*v*v - u*u*u) / 3;
+        else
+            d += (v*exp(trend*v) - u*exp(trend*u)) / trend - (exp(trend*v) - exp(trend*u)) / (trend*trend);
+    }
+    return d;
+}
+
+void LogNormalICP::numericGradient(Random *r, int max, double **g)
+{
+    // Central differences. Each costs two passes of logpost(), which
+    // are cheap next to sampling the episodes.
+    double h = 1e-5;
+    for (int i=0; i<ns; i++)
+        for (int j=0; j<n[i]; j++)
+        {
+            g[i][j] = 0;
+            if (!doit[i][j])
+                continue;
+            double x = par[i][j];
+            setNormal(i,j,x+h);
+            double f1 = logpost(r,max);
+            setNormal(i,j,x-h);
+            double f0 = logpost(r,max);
+            setNormal(i,j,x);
+            g[i][j] = (f1-f0) / (2*h);
+        }
+}
+
+void LogNormalICP::logpostGradient(Random *r, int max, double **g)
+{
+    if (!hasGradient())
+    {
+        numericGradient(r,max,g);
+        return;
+    }
+
+    for (int i=0; i<ns; i++)
+        for (int j=0; j<n[i]; j++)
+            g[i][j] = 0;
+
+    if (!max)
+        for (int i=0; i<ns; i++)
+            for (int j=0; j<n[i]; j++)
+                if (doit[i][j])
+                    g[i][j] -= (par[i][j]-primean[i][j]) / (pristdev[i][j]*pristdev[i][j]);
+
+    for (auto &e : events)
+        eventGradient(e.second,g);
+
+    double gaptrend = acquisitionGapTrend();
+    for (auto &gp : gaps)
+        gapGradient(gp.second,gaptrend,g);
+
+    for (int i=0; i<ns; i++)
+        for (int j=0; j<n[i]; j++)
+            if (!doit[i][j])
+                g[i][j] = 0;
+}
+
+std::vector<double> LogNormalICP::getGradient(Random *r, bool numeric)
+{
+    double **g = new double*[ns];
+    for (int i=0; i<ns; i++)
+        g[i] = cleanAlloc(n[i]);
+
+    if (numeric)
+        numericGradient(r,0,g);
+    else
+        logpostGradient(r,0,g);
+
+    std::vector<double> res;
+    for (int i=0; i<ns; i++)
+    {
+        if (i == 1 && nstates != 3)
+            continue;
+
+        for (int j=0; j<n[i]; j++)
+            res.push_back(g[i][j]);
+    }
+
+    for (int i=0; i<ns; i++)
+        delete [] g[i];
+    delete [] g;
+
+    return res;
+}
+
+double LogNormalICP::updateHMC(Random *r, double oldlogpost)
+{
+    // Leapfrog in the parameters scaled by sigmaprop, so the kinetic
+    // energy is half the sum of squares of p. Any position dependent
+    // force gives a reversible, volume preserving trajectory, so the
+    // accept step with the exact logpost() keeps the chain correct even
+    // where the gradient is approximate.
+
+    double **old = new double*[ns];
+    double **p = new double*[ns];
+    double **g = new double*[ns];
+    for (int i=0; i<ns; i++)
+    {
+        old[i] = cleanAlloc(n[i]);
+        p[i] = cleanAlloc(n[i]);
+        g[i] = cleanAlloc(n[i]);
+    }
+
+    double kinetic = 0;
+    for (int i=0; i<ns; i++)
+        for (int j=0; j<n[i]; j++)
+        {
+            old[i][j] = par[i][j];
+            if (doit[i][j])
+            {
+                p[i][j] = r->rnorm(0,1);
+                kinetic += p[i][j]*p[i][j] / 2;
+                nproposed[i][j]++;
+            }
+        }
+
+    double newlogpost = oldlogpost;
+    double eps = hmcstep;
+
+    logpostGradient(r,0,g);
+    for (int step=0; step<nleapfrog && std::isfinite(newlogpost); step++)
+    {
+        for (int i=0; i<ns; i++)
+            for (int j=0; j<n[i]; j++)
+                if (doit[i][j])
+                {
+                    p[i][j] += eps/2 * sigmaprop[i][j] * g[i][j];
+                    setNormal(i,j,par[i][j] + eps * sigmaprop[i][j] * p[i][j]);
+                }
+
+        newlogpost = logpost(r,0);
+        logpostGradient(r,0,g);
+
+        for (int i=0; i<ns; i++)
+            for (int j=0; j<n[i]; j++)
+                if (doit[i][j])
+                    p[i][j] += eps/2 * sigmaprop[i][j] * g[i][j];
+    }
+
+    double newkinetic = 0;
+    for (int i=0; i<ns; i++)
+        for (int j=0; j<n[i]; j++)
+            if (doit[i][j])
+                newkinetic += p[i][j]*p[i][j] / 2;
+
+    double d = (newlogpost - newkinetic) - (oldlogpost - kinetic);
+
+    // The usual target for HMC.
+    if (adapting)
+        hmcstep = adaptScale(hmcstep, d, 0.65, nadapt);
+
+    if (std::isfinite(newlogpost) && log(r->runif()) <= d)
+    {
+        oldlogpost = newlogpost;
+        for (int i=0; i<ns; i++)
+            for (int j=0; j<n[i]; j++)
+                if (doit[i][j])
+                    naccepted[i][j]++;
+    }
+    else
+    {
+        for (int i=0; i<ns; i++)
+            for (int j=0; j<n[i]; j++)
+                if (doit[i][j])
+                    setNormal(i,j,old[i][j]);
+    }
+
+    for (int i=0; i<ns; i++)
+    {
+        delete [] old[i];
+        delete [] p[i];
+        delete [] g[i];
+    }
+    delete [] old;
+    delete [] p;
+    delete [] g;
+
+    return oldlogpost;
 }
 } // namespace lognormal
@@ -73,15 +73,21 @@ double LogNormalMassAct::logAcquisitionRate(double time, PatientState *p, Locati
 double LogNormalMassAct::logAcquisitionGap(double t0, double t1, LocationState *s)
 {
     if (s->getSusceptible() > 0)
-        return - (t1 - t0) * s->getSusceptible() * exp(logAcquisitionRate(s->getColonized(),s->getTotal()));
+        return - (t1 - t0) * acquisitionGapRate(s);
     else
         return 0;
 }
 
-double* LogNormalMassAct::acquisitionRates(double time, PatientState *p, LocationState *s)
+double LogNormalMassAct::acquisitionGapRate(LocationState *s)
 {
-    double *P = new double[nstates];
+    if (s->getSusceptible() > 0)
+        return s->getSusceptible() * exp(logAcquisitionRate(s->getColonized(),s->getTotal()));
+    else
+        return 0;
+}
 
+double* LogNormalMassAct::acquisitionRates(double time, PatientState *p, LocationState *s, double *P)
+{
     if (nstates == 2)
     {
         P[0] = exp(logAcquisitionRate(s->getColonized(),s->getTotal()));
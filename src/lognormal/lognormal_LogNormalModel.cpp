@@ -1,4 +1,5 @@
 #include "lognormal/lognormal.h"
+#include <unordered_map>
 
 // protected
 namespace lognormal{
@@ -27,9 +28,7 @@ LogNormalModel::LogNormalModel(List *l, int nst, int abxtest, int nmetro, int fw
     abxbyonoff = 0;
     dumpers = new List();
 
-    //icp = ( l == 0 ? new LogNormalAbxICP(nst,0,nmetro) :  new MultiUnitAbxICP(l,nst,0,nmetro) );
-    icp = new LogNormalAbxICP(nst,0,nmetro);
-
+    icp = ( l == 0 ? new LogNormalAbxICP(nst,0,nmetro) :  new MultiUnitAbxICP(l,nst,0,nmetro) );
 
     isp = new InsituParams(nstates);
     ocp = new OutColParams(nstates,nmetro);
@@ -179,11 +178,96 @@ void LogNormalModel::read(istream &is)
     }
 }
 
+namespace {
+
+// The links of a system, facility or unit list, other than abxdose links,
+// in list order. The lists are in time order, so the first indexed link at
+// or after a time is found by binary search. Links added or not yet
+// removed since the index was made are reached by stepping back from it.
+struct LinkIndex
+{
+    std::vector<double> time;
+    std::vector<HistoryLink *> link;
+
+    inline void add(HistoryLink *x)
+    {
+        time.push_back(x->getEvent()->getTime());
+        link.push_back(x);
+    }
+
+    inline HistoryLink *first(double t) const
+    {
+        size_t i = std::lower_bound(time.begin(),time.end(),t) - time.begin();
+        return i < link.size() ? link[i] : 0;
+    }
+};
+
+// Where an abx on or off link with time t goes. As insertAsap() puts it,
+// this is before the first link at or after t in each of the system,
+// facility, unit and patient lists. pnext is a link of the patient at or
+// after t.
+struct AbxPlace
+{
+    const LinkIndex *sys;
+    const std::unordered_map<Facility *, LinkIndex> *fac;
+    const std::unordered_map<Unit *, LinkIndex> *unit;
+
+    void insert(HistoryLink *x, HistoryLink *pnext) const
+    {
+        Event *e = x->getEvent();
+        double t = e->getTime();
+
+        HistoryLink *s = sys->first(t);
+        while (s->sPrev() != 0 && s->sPrev()->getEvent()->getTime() >= t)
+            s = s->sPrev();
+
+        HistoryLink *f = fac->at(e->getFacility()).first(t);
+        while (f->fPrev() != 0 && f->fPrev()->getEvent()->getTime() >= t)
+            f = f->fPrev();
+
+        HistoryLink *u = unit->at(e->getUnit()).first(t);
+        while (u->uPrev() != 0 && u->uPrev()->getEvent()->getTime() >= t)
+            u = u->uPrev();
+
+        HistoryLink *p = pnext;
+        while (p->pPrev() != 0 && p->pPrev()->getEvent()->getTime() >= t)
+            p = p->pPrev();
+
+        x->insertBeforeS(s);
+        x->insertBeforeF(f);
+        x->insertBeforeU(u);
+        x->insertBeforeP(p);
+    }
+};
+
+} // namespace
+
 void LogNormalModel::handleAbxDoses(HistoryLink *shead)
 {
     if (abxbyonoff)
         return;
 
+    // Index the lists so that each on and off link is placed by a binary
+    // search rather than by scanning along the system list.
+    LinkIndex sindex;
+    std::unordered_map<Facility *, LinkIndex> findex;
+    std::unordered_map<Unit *, LinkIndex> uindex;
+
+    for (HistoryLink *l = shead; l != 0; l = l->sNext())
+    {
+        Event *e = l->getEvent();
+        if (e->getType() == abxdose)
+            continue;
+
+        sindex.add(l);
+        if (e->getFacility() != 0)
+            findex[e->getFacility()].add(l);
+        if (e->getUnit() != 0)
+            uindex[e->getUnit()].add(l);
+    }
+
+    AbxPlace place = {&sindex, &findex, &uindex};
+
     // Loop through all events picking out abxdose events.
     for (HistoryLink *l = shead; l != 0; )
     {
@@ -219,19 +303,10 @@ void LogNormalModel::handleAbxDoses(HistoryLink *shead)
         // Create off abx event with fix if it's implied to be out of unit.
         if (offpnext)
         {
-            HistoryLink *snext = 0;
-
             if (offpnext->getEvent()->isAdmission())
             {
                 offpnext = offpnext->pPrev();
                 offt = offpnext->getEvent()->getTime();
-                snext = offpnext;
-            }
-            else
-            {
-                for (snext = l; snext != 0; snext = snext->sNext())
-                    if (snext->getEvent()->getTime() >= offt)
-                        break;
             }
 
             Event *e = offpnext->getEvent();
@@ -245,26 +320,17 @@ void LogNormalModel::handleAbxDoses(HistoryLink *shead)
                     makePatientState(off->getPatient())
             );
 
-            loff->insertAsap(snext);
+            place.insert(loff,offpnext);
             dumpers->append(off);
         }
 
         // Crate on abx event with fix if its implied to be out of unit.
         if (onpnext)
         {
-            HistoryLink *snext = 0;
-
             if (onpnext->getEvent()->isAdmission())
             {
                 onpnext = onpnext->pPrev();
                 ont = onpnext->getEvent()->getTime();
-                snext = onpnext;
-            }
-            else
-            {
-                for (snext = l; snext != 0; snext = snext->sNext())
-                    if (snext->getEvent()->getTime() >= ont)
-                        break;
             }
 
             Event *e = onpnext->getEvent();
@@ -278,7 +344,7 @@ void LogNormalModel::handleAbxDoses(HistoryLink *shead)
                     makePatientState(on->getPatient())
             );
 
-            lon->insertAsap(snext);
+            place.insert(lon,onpnext);
             dumpers->append(on);
         }
 
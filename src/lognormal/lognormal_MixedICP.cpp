@@ -43,7 +43,12 @@ double MixedICP::acqRate(double time, int onabx, int everabx, double ncolabx, do
 
 double MixedICP::timePar()
 {
-    return par[0][4];
+    return par[0][timeIndex()];
+}
+
+int MixedICP::timeIndex() const
+{
+    return 4;
 }
 
 double MixedICP::unTransform(int i, int j)
@@ -53,6 +58,13 @@ double MixedICP::unTransform(int i, int j)
     return exp(par[i][j]);
 }
 
+double MixedICP::transform(int i, int j, double x)
+{
+    if (i == 0 && j == 1)
+        return logit(x);
+    return log(x);
+}
+
 void MixedICP::set(int i, int j, double value, int update, double prival, double priorn)
 {
     if (i == 0 && j == 1)
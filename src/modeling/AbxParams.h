@@ -32,10 +32,19 @@ public:
 
 	virtual double logProb(infect::HistoryLink *h) override;
 	virtual double logProbGap(infect::HistoryLink *g, infect::HistoryLink *h) override;
+	virtual double logProbGaps(const GapTable &t) override;
 	virtual void count(infect::HistoryLink *h) override;
 	virtual void countGap(infect::HistoryLink *g, infect::HistoryLink *h) override;
+	virtual Counts *newCounts() override;
+	virtual void countInto(infect::HistoryLink *h, Counts *c) override;
+	virtual void countGapInto(infect::HistoryLink *g, infect::HistoryLink *h, Counts *c) override;
+	virtual void addCounts(Counts *c) override;
 	virtual void initCounts() override;
 	virtual void update(Random *r, bool max) override;
+	virtual double countedLogLikelihood() override;
+	virtual std::vector<double> getState() const override;
+	virtual void setState(const std::vector<double> &x) override;
+	virtual void setValues(const std::vector<double> &x) override;
 
 // Personal accessors.
 	virtual void set(int i, double value, int update, double prival, double prin);
@@ -34,7 +34,7 @@ public:
 
 	virtual void sampleEpisodes(infect::SystemHistory *h, int max, Random *rand) override
 	{
-		ConstrainedSimulator::sampleEpisodes(this,h,max,rand);
+		addLogLikelihood(ConstrainedSimulator::sampleEpisodes(this,h,max,rand));
 	}
 
 };
@@ -62,14 +62,43 @@ protected:
 		return nullevent;
 	}
 
-	static void getProposal(UnitLinkedModel *mod, infect::EpisodeHistory *h, int *nsim, double **times, int **states);
+	static void getProposal(UnitLinkedModel *mod, infect::EpisodeHistory *h, Arena *arena, int *nsim, double **times, int **states);
 	static void putProposal(UnitLinkedModel *mod, infect::EpisodeHistory *h, int nsim, double *times, int *states);
-	static Markov *getMarkovProcess(UnitLinkedModel *mod, infect::HistoryLink *p, Random *rand, int *nalloc, double **mytime, bool **mydoit, double ***myS, double ****myQ);
+	static int getMarkovProcess(UnitLinkedModel *mod, infect::HistoryLink *p, Arena *arena, double **mytime, bool **mydoit, double ***myS, double ****myQ);
+
+	// Splits the n points of a patient's Markov process into the blocks
+	// resampled in turn by sampleHistory(). Block k runs from point a[k]
+	// to b[k], whose states are held fixed; -1 and n mean a free end.
+	// Episode i covers points first[i] to last[i]. Returns the number of
+	// blocks.
+	static int getBlocks(UnitLinkedModel *mod, int n, double *time, bool *doit, int neps, Arena *arena, int **first, int **last, int **a, int **b);
+	// The state at time t of an episode path.
+	static int stateAt(int m, double *times, int *states, double t);
+	// The old episode path with its switches in (ta,tb] replaced by those
+	// of the new one, and its admission state too if admit is set.
+	static int splicePath(Arena *arena, int om, double *ot, int *os, int nm, double *nt, int *ns, bool admit, double ta, double tb, double **times, int **states);
+
+	// Episode sampling for a patient only touches the timelines of the
+	// units the patient visits. These split the patients into batches of
+	// tasks whose unit sets do not overlap, so the tasks within a batch
+	// can be sampled in parallel.
+	static void getBatches(infect::SystemHistory *h, vector< vector< vector<infect::HistoryLink *> > > &batches);
+	static double sampleBatches(UnitLinkedModel *mod, infect::SystemHistory *h, int max, Random *rand, int nthreads);
 
 public:
-	static void sampleEpisodes(UnitLinkedModel *mod, infect::SystemHistory *h, int max, Random *rand);
-	static void sampleHistory(UnitLinkedModel *mod, infect::SystemHistory *hist, infect::HistoryLink *plink, int max, Random *rand);
+	// These return the change in the log likelihood from the accepted
+	// proposals. The model's episode tries and window settings choose
+	// between the whole path, block wise and multiple-try updates.
+	static double sampleEpisodes(UnitLinkedModel *mod, infect::SystemHistory *h, int max, Random *rand);
+	static double sampleHistory(UnitLinkedModel *mod, infect::SystemHistory *hist, infect::HistoryLink *plink, int max, Random *rand);
 	static void initEpisodeHistory(UnitLinkedModel *mod, infect::EpisodeHistory *eh, bool haspostest);
+
+	// The current state of an episode in the form used by the proposals:
+	// the state at admission, then the time of and state after each
+	// switch. getEpisodeState() appends to times and states and returns
+	// the number of entries.
+	static int getEpisodeState(UnitLinkedModel *mod, infect::EpisodeHistory *h, vector<double> &times, vector<int> &states);
+	static void setEpisodeState(UnitLinkedModel *mod, infect::EpisodeHistory *h, int nsim, double *times, int *states);
 	static void cheatInitEpisodeHistory(UnitLinkedModel *mod, infect::EpisodeHistory *eh);
 };
 
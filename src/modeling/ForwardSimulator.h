@@ -14,7 +14,7 @@ protected:
 	static infect::EpisodeHistory *getEpisodeHistory(Map *map, infect::HistoryLink *h);
 	static void randImportState(UnitLinkedModel *mod, infect::HistoryLink *h, infect::EpisodeHistory *eh, Random *rand);
 	static void randTestResult(UnitLinkedModel *mod, infect::HistoryLink *h, Random *rand);
-	static double randTimeToEvent(UnitLinkedModel *mod, double atime, infect::HistoryLink *ph, infect::HistoryLink *uh, Random *rand);
+	static double eventRate(UnitLinkedModel *mod, double atime, infect::HistoryLink *ph, infect::HistoryLink *uh);
 
 };
 
@@ -0,0 +1,64 @@
+#ifndef ALUN_MODELING_GAPTABLE_H
+#define ALUN_MODELING_GAPTABLE_H
+
+#include "../infect/infect.h"
+#include <vector>
+
+namespace models {
+
+/*
+	The gaps between consecutive events in the unit timelines of a
+	FlatHistory, in struct of arrays columns, with the unit census over
+	each gap. Only the gaps that UnitLinkedModel::logLikelihood() counts
+	are included, that is those ending in an event other than a start or
+	stop.
+	Counts are held as doubles, and the logs and reciprocals that the
+	acquisition rates need are worked out once when the table is built, so
+	that Parameters::logProbGaps() can evaluate all the gap terms of the
+	likelihood in straight loops over the columns.
+	The abx columns are zero unless the unit states are AbxLocationStates.
+*/
+struct GapTable
+{
+	// Links at the start and end of each gap.
+	std::vector<infect::HistoryLink *> prev;
+	std::vector<infect::HistoryLink *> link;
+
+	// Gap start and end times, and length.
+	std::vector<double> t0;
+	std::vector<double> t1;
+	std::vector<double> dt;
+
+	// Unit census over the gap.
+	std::vector<double> tot;
+	std::vector<double> col;
+	std::vector<double> lat;
+	std::vector<double> sus;
+
+	// Patients currently on, and ever on, antibiotics.
+	std::vector<double> abxcol;
+	std::vector<double> abxlat;
+	std::vector<double> abxsus;
+	std::vector<double> evercol;
+	std::vector<double> everlat;
+	std::vector<double> eversus;
+
+	// log(tot) and log(col), 1/tot, and 1 where col > 0. Each is 0 where
+	// the count is 0.
+	std::vector<double> logtot;
+	std::vector<double> logcol;
+	std::vector<double> invtot;
+	std::vector<double> hascol;
+
+	inline unsigned int size() const
+	{
+		return dt.size();
+	}
+
+	// Fills the table from f, reusing storage.
+	void rebuild(infect::FlatHistory *f);
+};
+
+} // namespace models
+
+#endif // ALUN_MODELING_GAPTABLE_H
@@ -23,11 +23,13 @@ public:
 		return nstates;
 	}
 
-	virtual double *acquisitionRates(double time, infect::PatientState *p, infect::LocationState *s) = 0;
+	// acquisitionRates() and rateMatrix() fill and return the caller's
+	// buffers, of size nstates and nstates by nstates.
+	virtual double *acquisitionRates(double time, infect::PatientState *p, infect::LocationState *s, double *P) = 0;
 
 	virtual double eventRate(double time, EventCode c, infect::PatientState *p, infect::LocationState *s) = 0;
 
-	virtual double **rateMatrix(double time, infect::PatientState *p, infect::LocationState *u) = 0;
+	virtual double **rateMatrix(double time, infect::PatientState *p, infect::LocationState *u, double **Q) = 0;
 };
 
 } // namespace models
@@ -30,13 +30,20 @@ public:
 	virtual std::vector<std::string> paramNames() const override;
     virtual std::vector<double> getValues() const override;
 	virtual string header() const override;
-	virtual double *statusProbs() const;
+	virtual double *statusProbs(double *P) const;
 // Implement Parameters.
 
 	virtual double logProb(infect::HistoryLink *h) override;
 	virtual void initCounts() override;
 	virtual void count(infect::HistoryLink *h) override;
+	virtual Counts *newCounts() override;
+	virtual void countInto(infect::HistoryLink *h, Counts *c) override;
+	virtual void addCounts(Counts *c) override;
 	virtual void update(Random *r, bool max) override;
+	virtual double countedLogLikelihood() override;
+	virtual std::vector<double> getState() const override;
+	virtual void setState(const std::vector<double> &x) override;
+	virtual void setValues(const std::vector<double> &x) override;
 // Personal accessors.
 
 	inline int getNStates() const override
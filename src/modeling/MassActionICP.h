@@ -46,9 +46,9 @@ public:
 	virtual string header() const override;
 // Implement InColParams.
 
-	virtual double *acquisitionRates(double time, infect::PatientState *p, infect::LocationState *s) override;
+	virtual double *acquisitionRates(double time, infect::PatientState *p, infect::LocationState *s, double *P) override;
 	virtual double eventRate(double time, EventCode c, infect::PatientState *p, infect::LocationState *s) override;
-	virtual double **rateMatrix(double time, infect::PatientState *p, infect::LocationState *u) override;
+	virtual double **rateMatrix(double time, infect::PatientState *p, infect::LocationState *u, double **Q) override;
 // Implement Parameters.
 
 	virtual double logProb(infect::HistoryLink *h) override;
@@ -16,6 +16,13 @@ private:
 	Map *admits;
 	int countscount;
 
+	// Admissions found in part of the history.
+	class AdmissionCounts : public Counts
+	{
+	public:
+		std::vector<infect::HistoryLink *> admits;
+	};
+
 	double *rates;
 	double *priorshape;
 	double *priorrate;
@@ -26,6 +33,10 @@ private:
 
 	int *doit;
 
+	double sigmaprop; //< Proposal standard deviation of the log rates.
+	double nadapt; //< Adaptive proposals made.
+	bool adapting;
+
 	double sumrates;
 	complex<double> l2;
 	complex<double> l3;
@@ -53,8 +64,8 @@ public:
 	OutColParams(int nst, int nmet);
 	~OutColParams();
 	virtual double transitionProb(InfectionStatus p, InfectionStatus c, double t);
-	double *equilibriumProbs();
-	double **rateMatrix();
+	double *equilibriumProbs(double *p);
+	double **rateMatrix(double **q);
 	virtual void setNMetro(int n);
 
 
@@ -65,7 +76,15 @@ public:
 	virtual double logProb(infect::HistoryLink *h) override;
 	virtual void initCounts() override;
 	virtual void count(infect::HistoryLink *h) override;
+	virtual Counts *newCounts() override;
+	virtual void countInto(infect::HistoryLink *h, Counts *c) override;
+	virtual void addCounts(Counts *c) override;
 	virtual void update(Random *r, bool max) override;
+	virtual double countedLogLikelihood() override;
+	virtual std::vector<double> getState() const override;
+	virtual void setState(const std::vector<double> &x) override;
+	virtual void setValues(const std::vector<double> &x) override;
+	virtual void setAdapting(bool a) override;
     virtual std::vector<double> getValues() const override;
 	virtual std::vector<std::string> paramNames() const override;
 
@@ -2,6 +2,7 @@
 #define ALUN_MODELING_PARAMETERS_H
 
 #include "../infect/infect.h"
+#include "GapTable.h"
 #include <string>
 #include <vector>
 
@@ -17,13 +18,60 @@ public:
 	virtual double logProb(infect::HistoryLink *h) = 0;
 	virtual double logProbGap(infect::HistoryLink *g, infect::HistoryLink *h) { return 0; }
 
+	// Sum of logProbGap() over the gaps in t. Parameters whose gap terms
+	// only depend on the census override this to work from the columns.
+	virtual double logProbGaps(const GapTable &t);
+
 	virtual void initCounts() = 0;
 	virtual void count(infect::HistoryLink *h) = 0;
 	virtual void countGap(infect::HistoryLink *g, infect::HistoryLink *h) { }
 
+	// Counts for part of the history, kept apart from this object's so
+	// that parts can be counted on different threads. countInto() and
+	// countGapInto() add to c what count() and countGap() would add here,
+	// and addCounts() then adds c to this object's counts.
+	// newCounts() returns 0 if the counts can't be split up this way.
+	class Counts
+	{
+	public:
+		virtual ~Counts() { }
+	};
+
+	// Counts that are a flat array of doubles.
+	class ArrayCounts : public Counts
+	{
+	public:
+		std::vector<double> x;
+		ArrayCounts(int n) : x(n,0.0) { }
+	};
+
+	virtual Counts *newCounts() { return 0; }
+	virtual void countInto(infect::HistoryLink *h, Counts *c) { }
+	virtual void countGapInto(infect::HistoryLink *g, infect::HistoryLink *h, Counts *c) { }
+	virtual void addCounts(Counts *c) { }
+
 	virtual void update(Random *r, bool max) = 0;
 	virtual void update(Random *r);
 
+	// Log likelihood of the events and gaps counted since initCounts(), at
+	// the current parameter values, or NaN if it can't be found from the
+	// counts alone.
+	virtual double countedLogLikelihood();
+
+	// The values changed by update(), for checkpoints. setState() puts
+	// them back exactly, along with anything worked out from them.
+	virtual std::vector<double> getState() const;
+	virtual void setState(const std::vector<double> &x);
+
+	// Sets the values returned by getValues(), as kept in the output of
+	// runMCMC(), for instance to simulate from a posterior draw. Proposal
+	// scales and priors are left as they are.
+	virtual void setValues(const std::vector<double> &x);
+
+	// While adapting, update() tunes its proposal scales toward a target
+	// acceptance rate. It is only set during burn-in, so that the chain
+	// kept afterwards has fixed proposals.
+	virtual void setAdapting(bool a) { }
 
 	virtual int getNStates() const = 0;
 	//virtual int nParam() const = 0;
@@ -31,6 +79,12 @@ public:
 	virtual int eventIndex(EventCode e);
 	virtual int stateIndex(InfectionStatus s) const;
 	virtual int testResultIndex(EventCode e) const;
+
+protected:
+
+	// Robbins-Monro step of proposal scale sigma toward acceptance rate
+	// target, after the k'th adaptive proposal had log acceptance ratio d.
+	static double adaptScale(double sigma, double d, double target, double k);
 };
 
 } // namespace models
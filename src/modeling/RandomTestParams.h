@@ -32,6 +32,7 @@ public:
 	}
 
 	virtual double logProbGap(infect::HistoryLink *g, infect::HistoryLink *h) override;
+	virtual double logProbGaps(const GapTable &t) override;
 	inline void initCounts() override
 	{
 		TestParams::initCounts();
@@ -49,7 +50,15 @@ public:
 	}
 
 	virtual void countGap(infect::HistoryLink *g, infect::HistoryLink *h) override;
+	virtual Counts *newCounts() override;
+	virtual void countInto(infect::HistoryLink *h, Counts *c) override;
+	virtual void countGapInto(infect::HistoryLink *g, infect::HistoryLink *h, Counts *c) override;
+	virtual void addCounts(Counts *c) override;
 	virtual void update(Random *r, bool max) override;
+	virtual double countedLogLikelihood() override;
+	virtual std::vector<double> getState() const override;
+	virtual void setState(const std::vector<double> &x) override;
+	virtual void setValues(const std::vector<double> &x) override;
 
 // Personal accessors.
 
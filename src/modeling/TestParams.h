@@ -38,14 +38,21 @@ public:
 	virtual string header() const override;
 	virtual int getNStates() const override;
 	virtual double eventProb(InfectionStatus s, int onabx, EventCode e) const;
-	virtual double* resultProbs(int onabx, EventCode e) const;
+	virtual double* resultProbs(int onabx, EventCode e, double *P) const;
 
 // Implement Parameters.
 
 	virtual double logProb(infect::HistoryLink *h) override;
 	virtual void initCounts() override;
 	virtual void count(infect::HistoryLink *h) override;
+	virtual Counts *newCounts() override;
+	virtual void countInto(infect::HistoryLink *h, Counts *c) override;
+	virtual void addCounts(Counts *c) override;
 	virtual void update(Random *r, bool max = false) override;
+	virtual double countedLogLikelihood() override;
+	virtual std::vector<double> getState() const override;
+	virtual void setState(const std::vector<double> &x) override;
+	virtual void setValues(const std::vector<double> &x) override;
 	virtual void update_max(Random *r);
 
 // Personal accessors.
@@ -42,14 +42,21 @@ public:
 	inline bool getUseAbx(){return useabx;}
 	virtual double eventProb(InfectionStatus s, int onabx, EventCode e) const override;
 
-	virtual double *resultProbs(int onabx, EventCode e) const override;
+	virtual double *resultProbs(int onabx, EventCode e, double *P) const override;
 
 // Implement Parameters.
 
 	virtual double logProb(infect::HistoryLink *const h) const;
 	virtual void initCounts() override;
 	virtual void count(infect::HistoryLink * const h) override;
+	virtual Counts *newCounts() override;
+	virtual void countInto(infect::HistoryLink *h, Counts *c) override;
+	virtual void addCounts(Counts *c) override;
 	virtual void update(Random *r, bool max) override;
+	virtual double countedLogLikelihood() override;
+	virtual std::vector<double> getState() const override;
+	virtual void setState(const std::vector<double> &x) override;
+	virtual void setValues(const std::vector<double> &x) override;
 
 // Personal accessors.
 
@@ -7,6 +7,8 @@
 #include "TestParams.h"
 #include "InColParams.h"
 #include "AbxParams.h"
+#include "GapTable.h"
+#include <functional>
 
 /*
 	Manages models where it is only required that the
@@ -21,6 +23,12 @@ protected:
 
 	int nstates;
 	int forwardEnabled;
+	int episodeThreads;
+	int unitThreads;
+	int episodeTries;
+	double episodeWindow;
+	bool adaptive;
+	bool columnar;
 
 	InsituParams *isp;
 	OutColParams *ocp;
@@ -29,16 +37,94 @@ protected:
 	InColParams *icp;
 	AbxParams *abxp;
 
+	// Running total of the log likelihood, set from the parameters'
+	// counts by update() and moved on by the changes accepted in
+	// sampleEpisodes().
+	double loglik;
+	bool loglikvalid;
+	bool counthidden;
+	std::vector<infect::HistoryLink *> unittails;
+
+	// Gaps of the FlatHistory with version gapversion, for the columnar
+	// likelihood.
+	GapTable gaps;
+	unsigned long gapversion;
+
+	void countLogLikelihood();
+
+	// Runs f(u) for u = 0,...,n-1 on up to unitThreads threads, which
+	// take the units in turn as they come free.
+	void forEachUnit(int n, const std::function<void(int)> &f);
+
+	// Counts the units from their first links with separate counts for
+	// each unit, made in parallel, then added to the parameters' counts
+	// in unit order. Returns false, having counted nothing, if some of the
+	// parameters can't split their counts.
+	bool countUnitStats(const std::vector<infect::HistoryLink *> &heads);
+
+	// Index in a unit's counts of each set of parameters.
+	enum { cisp, cocp, csurv, cclin, cicp, cabx, ncounts };
+
+	inline void addLogLikelihood(double x)
+	{
+		if (loglikvalid)
+			loglik += x;
+	}
+
 public:
 
 	UnitLinkedModel(int ns, int fw, int ch);
 	virtual double logLikelihood(infect::SystemHistory *hist) override;
+	virtual double logLikelihood(infect::FlatHistory *f) override;
+	virtual bool usesFlatHistory() const override {return columnar;}
 
 public:
 
 	inline int isForwardEnabled() const {return forwardEnabled;}
+	// Only applies to histories made afterwards, whose states forward
+	// simulation needs.
+	inline void setForwardEnabled(int f) {forwardEnabled = f;}
 	inline int getNStates() const {return nstates;}
 
+	// Number of threads used to sample episodes. Zero gives the original
+	// sequential sweep over patients; one or more gives the batched sweep
+	// of ConstrainedSimulator, which does not depend on the thread count.
+	inline int getEpisodeThreads() const {return episodeThreads;}
+	inline void setEpisodeThreads(int n) {episodeThreads = n;}
+
+	// Number of threads used to count the sufficient statistics and find
+	// the likelihood unit by unit. Zero gives the original sequential
+	// loop over units; one or more count each unit separately and add the
+	// counts in unit order, so the result does not depend on the thread
+	// count.
+	inline int getUnitThreads() const {return unitThreads;}
+	inline void setUnitThreads(int n) {unitThreads = n;}
+
+	// Number of candidate paths drawn for each episode proposal. More than
+	// one gives a multiple-try Metropolis update.
+	inline int getEpisodeTries() const {return episodeTries;}
+	inline void setEpisodeTries(int n) {episodeTries = n < 1 ? 1 : n;}
+
+	// Zero resamples each patient's whole path at once. Otherwise the path
+	// is resampled one episode at a time, with episodes split into windows
+	// of about this length.
+	inline double getEpisodeWindow() const {return episodeWindow;}
+	inline void setEpisodeWindow(double w) {episodeWindow = w;}
+
+	// Whether the parameters tune their proposal scales during burn-in.
+	// The chain runner calls setAdapting() at the start and end of burn-in,
+	// which does nothing unless this is set.
+	inline bool isAdaptive() const {return adaptive;}
+	inline void setAdaptive(bool a) {adaptive = a;}
+	void setAdapting(bool a);
+
+	// If set, logLikelihood(FlatHistory *) evaluates the gap terms from a
+	// GapTable, built once for each copy of the history, by the
+	// parameters' logProbGaps(), rather than link by link. Otherwise the
+	// Sampler makes no flat copy and works on the SystemHistory.
+	inline bool isColumnar() const {return columnar;}
+	inline void setColumnar(bool c) {columnar = c;}
+
 	// Accessors
 	inline InsituParams* getInsituParams() const {return isp;}
 	inline OutColParams* getOutColParams() const {return ocp;}
@@ -91,6 +177,14 @@ public:
 
 
 	void countUnitStats(infect::HistoryLink *l);
+	void countGapStats(infect::HistoryLink *prev, infect::HistoryLink *h);
+	void countEventStats(infect::HistoryLink *h);
+	// As above, but into the counts c, indexed as for countUnitStats(),
+	// rather than the parameters' own if c is not 0.
+	void countGapStats(infect::HistoryLink *prev, infect::HistoryLink *h, Parameters::Counts **c);
+	void countEventStats(infect::HistoryLink *h, Parameters::Counts **c);
+	void initParameterCounts();
+	void updateParameters(Random *r, int max);
 	virtual double logLikelihood(infect::EpisodeHistory *h);
 	virtual double logLikelihood(infect::EpisodeHistory *h, int opt);
 	virtual double logLikelihood(infect::Patient *pat, infect::HistoryLink *h);
@@ -99,6 +193,8 @@ public:
 	virtual double logLikelihood(infect::HistoryLink *h, int dogap);
 	void update(infect::SystemHistory *hist, Random *r);
 	void update(infect::SystemHistory *hist, Random *r, int max)  override;
+	virtual bool runningLogLikelihood(double *x) override;
+	virtual void resetLogLikelihood() override;
 	
 	// Diagnostic function to get individual log likelihoods
 	std::vector<double> getHistoryLinkLogLikelihoods(infect::SystemHistory *hist);
@@ -16,6 +16,7 @@
     #include "../infect/infect.h"
 
 	// Model parameter classes.
+	#include "GapTable.h"
 	#include "Parameters.h"
 	#include "TestParams.h"
 	#include "TestParamsAbx.h"
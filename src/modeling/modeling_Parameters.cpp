@@ -7,6 +7,47 @@ void Parameters::update(Random *r)
     update(r,0);
 }
 
+double Parameters::countedLogLikelihood()
+{
+    return std::numeric_limits<double>::quiet_NaN();
+}
+
+double Parameters::logProbGaps(const GapTable &t)
+{
+    double x = 0;
+    for (unsigned int i=0; i<t.size(); i++)
+        x += logProbGap(t.prev[i],t.link[i]);
+    return x;
+}
+
+std::vector<double> Parameters::getState() const
+{
+    throw std::runtime_error("Checkpoints are not supported for " + className());
+}
+
+void Parameters::setState(const std::vector<double> &x)
+{
+    throw std::runtime_error("Checkpoints are not supported for " + className());
+}
+
+void Parameters::setValues(const std::vector<double> &x)
+{
+    throw std::runtime_error("Setting values is not supported for " + className());
+}
+
+double Parameters::adaptScale(double sigma, double d, double target, double k)
+{
+    // The acceptance probability moves the scale rather than the accept
+    // or reject outcome, which is noisier. A NaN ratio counts as a reject.
+    double a = d >= 0 ? 1 : (d < 0 ? exp(d) : 0);
+    double s = sigma * exp((a - target) / pow(k, 0.6));
+    if (s < 1e-5)
+        return 1e-5;
+    if (s > 1e2)
+        return 1e2;
+    return s;
+}
+
 int Parameters::eventIndex(EventCode e)
 {
     switch(e)
@@ -52,10 +52,8 @@ double TestParams::eventProb(InfectionStatus s, int onabx, EventCode e) const
     return ( i < 0 || j < 0 ? 0 : probs[i][j] );
 }
 
-double* TestParams::resultProbs(int onabx, EventCode e) const
+double* TestParams::resultProbs(int onabx, EventCode e, double *P) const
 {
-    double *P = cleanAlloc(nstates);
-
     if (nstates == 2)
     {
         P[0] = eventProb(uncolonized,0,e);
@@ -98,6 +96,39 @@ void TestParams::count(infect::HistoryLink *h)
     counts[i][j] += 1;
 }
 
+Parameters::Counts *TestParams::newCounts()
+{
+    return new ArrayCounts(n*m);
+}
+
+void TestParams::countInto(infect::HistoryLink *h, Counts *c)
+{
+    int i = stateIndex(h->getPState()->infectionStatus());
+    int j = testResultIndex(h->getEvent()->getType());
+    if (i < 0 || j < 0)
+        return;
+
+    ((ArrayCounts *)c)->x[i*m+j] += 1;
+}
+
+void TestParams::addCounts(Counts *c)
+{
+    double *x = ((ArrayCounts *)c)->x.data();
+    for (int i=0; i<n; i++)
+        for (int j=0; j<m; j++)
+            counts[i][j] += x[i*m+j];
+}
+
+double TestParams::countedLogLikelihood()
+{
+    double x = 0;
+    for (int i=0; i<n; i++)
+        for (int j=0; j<m; j++)
+            if (counts[i][j] > priors[i][j])
+                x += (counts[i][j]-priors[i][j]) * logprobs[i][j];
+    return x;
+}
+
 void TestParams::update(Random *r, bool max)
 {
     double *newpos = new double[n];
@@ -200,6 +231,34 @@ std::vector<double> TestParams::getValues() const
     return res;
 
 }
+std::vector<double> TestParams::getState() const
+{
+    std::vector<double> x(n);
+    for (int i=0; i<n; i++)
+        x[i] = probs[i][1];
+    return x;
+}
+
+void TestParams::setState(const std::vector<double> &x)
+{
+    if ((int) x.size() != n)
+        throw std::runtime_error("Wrong number of values for TestParams state");
+    for (int i=0; i<n; i++)
+        set(i,x[i]);
+}
+
+void TestParams::setValues(const std::vector<double> &x)
+{
+    // As in getValues(), the latent state's value is only there with three
+    // states.
+    if ((int) x.size() != (nstates == 3 ? 3 : 2))
+        throw std::runtime_error("Wrong number of values for TestParams");
+    int k = 0;
+    for (int i=0; i<n; i++)
+        if (i != 1 || nstates == 3)
+            set(i,x[k++]);
+}
+
 void TestParams::write (ostream &os) const
 {
     char *buffer = new char[100];
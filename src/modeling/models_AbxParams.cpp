@@ -101,6 +101,29 @@ double AbxParams::logProbGap(infect::HistoryLink *g, infect::HistoryLink *h)
         );
 }
 
+double AbxParams::logProbGaps(const GapTable &t)
+{
+    const double *dt = t.dt.data();
+    const double *sus = t.sus.data();
+    const double *lat = t.lat.data();
+    const double *col = t.col.data();
+    const double *asus = t.abxsus.data();
+    const double *alat = t.abxlat.data();
+    const double *acol = t.abxcol.data();
+
+    double s = 0;
+    double l = 0;
+    double c = 0;
+    for (unsigned int i=0; i<t.size(); i++)
+    {
+        s += dt[i] * (sus[i]-asus[i]);
+        l += dt[i] * (lat[i]-alat[i]);
+        c += dt[i] * (col[i]-acol[i]);
+    }
+
+    return - (s * rates[0] + l * rates[1] + c * rates[2]);
+}
+
 void AbxParams::count(infect::HistoryLink *h)
 {
     if (h->getEvent()->getType() == abxon)
@@ -120,6 +143,43 @@ void AbxParams::countGap(infect::HistoryLink *g, infect::HistoryLink *h)
     ratepar[2] += time * s->getNoAbxColonized();
 }
 
+// Shape counts then rate counts.
+
+Parameters::Counts *AbxParams::newCounts()
+{
+    return new ArrayCounts(2*n);
+}
+
+void AbxParams::countInto(infect::HistoryLink *h, Counts *c)
+{
+    if (h->getEvent()->getType() == abxon)
+    {
+        infect::AbxPatientState *ps = (infect::AbxPatientState *) h->getPState();
+        if (ps->onAbx() == 1)
+            ((ArrayCounts *)c)->x[stateIndex(ps->infectionStatus())] += 1;
+    }
+}
+
+void AbxParams::countGapInto(infect::HistoryLink *g, infect::HistoryLink *h, Counts *c)
+{
+    double time = h->getEvent()->getTime() - g->getEvent()->getTime();
+    infect::AbxLocationState *s = (infect::AbxLocationState *) h->uPrev()->getUState();
+    double *x = ((ArrayCounts *)c)->x.data() + n;
+    x[0] += time * s->getNoAbxSusceptible();
+    x[1] += time * s->getNoAbxLatent();
+    x[2] += time * s->getNoAbxColonized();
+}
+
+void AbxParams::addCounts(Counts *c)
+{
+    double *x = ((ArrayCounts *)c)->x.data();
+    for (int i=0; i<n; i++)
+    {
+        shapepar[i] += x[i];
+        ratepar[i] += x[n+i];
+    }
+}
+
 void AbxParams::initCounts()
 {
     for (int i=0; i<n; i++)
@@ -129,6 +189,18 @@ void AbxParams::initCounts()
     }
 }
 
+double AbxParams::countedLogLikelihood()
+{
+    double x = 0;
+    for (int i=0; i<n; i++)
+    {
+        if (shapepar[i] > priorshape[i])
+            x += (shapepar[i]-priorshape[i]) * log(rates[i]);
+        x -= (ratepar[i]-priorrate[i]) * rates[i];
+    }
+    return x;
+}
+
 void AbxParams::update(Random *r, bool max)
 {
     double *newrates = new double[n];
@@ -182,6 +254,29 @@ std::vector<double> AbxParams::getValues() const
     vals.push_back(rates[2]);
     return vals;
 }
+std::vector<double> AbxParams::getState() const
+{
+    return std::vector<double>(rates, rates+n);
+}
+
+void AbxParams::setState(const std::vector<double> &x)
+{
+    if ((int) x.size() != n)
+        throw std::runtime_error("Wrong number of values for AbxParams state");
+    for (int i=0; i<n; i++)
+        rates[i] = x[i];
+}
+
+void AbxParams::setValues(const std::vector<double> &x)
+{
+    if ((int) x.size() != nstates)
+        throw std::runtime_error("Wrong number of values for AbxParams");
+    int k = 0;
+    for (int i=0; i<n; i++)
+        if (i != 1 || nstates == 3)
+            rates[i] = x[k++];
+}
+
 void AbxParams::write(ostream &os) const
 {
     char *buffer = new char[100];
@@ -1,36 +1,43 @@
 #include "modeling/modeling.h"
 
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
 namespace models {
 
 // protected methods
-void ConstrainedSimulator::getProposal(UnitLinkedModel *mod, infect::EpisodeHistory *h, int *nsim, double **times, int **states)
+void ConstrainedSimulator::getProposal(UnitLinkedModel *mod, infect::EpisodeHistory *h, Arena *arena, int *nsim, double **times, int **states)
 {
-    vector<int> vs;
-    vector<double> vt;
-    vs.push_back(0);
-    vt.push_back(h->admissionTime());
+    int n = 1;
+    for (infect::HistoryLink *l = h->getProposalHead(); l != 0; l = l->hNext())
+        if (l->isLinked())
+            n++;
+
+    *nsim = n;
+    *states = arena->alloc<int>(n);
+    *times = arena->alloc<double>(n);
 
+    (*states)[0] = 0;
+    (*times)[0] = h->admissionTime();
+
+    n = 1;
     for (infect::HistoryLink *l = h->getProposalHead(); l != 0; l = l->hNext())
     {
         if (!l->isLinked())
         {
-            vs[0] = stateAfterEvent(mod->getNStates(),l->getEvent()->getType());
+            (*states)[0] = stateAfterEvent(mod->getNStates(),l->getEvent()->getType());
         }
         else
         {
-            vs.push_back(stateAfterEvent(mod->getNStates(),l->getEvent()->getType()));
-            vt.push_back(l->getEvent()->getTime());
+            (*states)[n] = stateAfterEvent(mod->getNStates(),l->getEvent()->getType());
+            (*times)[n] = l->getEvent()->getTime();
+            n++;
         }
     }
-
-    *nsim = vs.size();
-    *states = new int[*nsim];
-    *times = new double[*nsim];
-    for (int i=0; i<(*nsim); i++)
-    {
-        (*states)[i] = vs[i];
-        (*times)[i] = vt[i];
-    }
 }
 
 void ConstrainedSimulator::putProposal(UnitLinkedModel *mod, infect::EpisodeHistory *h, int nsim, double *times, int *states)
@@ -63,8 +70,41 @@ void ConstrainedSimulator::putProposal(UnitLinkedModel *mod, infect::EpisodeHist
         h->proposeSwitch(mod->makeHistLink(f,u,p,times[i],eventOutOfState(mod->getNStates(),states[i-1]),1));
 }
 
-Markov* ConstrainedSimulator::getMarkovProcess(UnitLinkedModel *mod, infect::HistoryLink *p, Random *rand, int *nalloc, double **mytime, bool **mydoit, double ***myS, double ****myQ)
+int ConstrainedSimulator::getEpisodeState(UnitLinkedModel *mod, infect::EpisodeHistory *h, vector<double> &times, vector<int> &states)
+{
+    size_t first = states.size();
+    states.push_back(0);
+    times.push_back(h->admissionTime());
+
+    for (infect::HistoryLink *l = h->getHistoryHead(); l != 0; l = l->hNext())
+    {
+        if (!l->isLinked())
+        {
+            states[first] = stateAfterEvent(mod->getNStates(),l->getEvent()->getType());
+        }
+        else
+        {
+            states.push_back(stateAfterEvent(mod->getNStates(),l->getEvent()->getType()));
+            times.push_back(l->getEvent()->getTime());
+        }
+    }
+
+    return states.size() - first;
+}
+
+void ConstrainedSimulator::setEpisodeState(UnitLinkedModel *mod, infect::EpisodeHistory *h, int nsim, double *times, int *states)
+{
+    // As for an accepted proposal in sampleHistory().
+    h->unapply();
+    putProposal(mod,h,nsim,times,states);
+    h->installProposal();
+    h->apply();
+    h->clearProposal();
+}
+
+int ConstrainedSimulator::getMarkovProcess(UnitLinkedModel *mod, infect::HistoryLink *p, Arena *arena, double **mytime, bool **mydoit, double ***myS, double ****myQ)
 {
+    int nst = mod->getNStates();
     infect::Patient *pat = p->getEvent()->getPatient();
     int n = 0;
     infect::HistoryLink *l;
@@ -76,10 +116,10 @@ Markov* ConstrainedSimulator::getMarkovProcess(UnitLinkedModel *mod, infect::His
         l = (l->getEvent()->getPatient()==pat && l->getEvent()->getType()==discharge ? l->pNext() : l->uNext());
     }
 
-    double *time = new double[n];
-    bool *doit = new bool[n];
-    double **S = new double*[n];
-    double ***Q = new double **[n];
+    double *time = arena->alloc<double>(n);
+    bool *doit = arena->alloc<bool>(n);
+    double **S = arena->alloc<double *>(n);
+    double ***Q = arena->alloc<double **>(n);
 
     for
         (
@@ -102,10 +142,10 @@ Markov* ConstrainedSimulator::getMarkovProcess(UnitLinkedModel *mod, infect::His
             case insitu2:
                 if (first)
                 {
-                    S[n] = mod->getInsituParams()->statusProbs();
+                    S[n] = mod->getInsituParams()->statusProbs(arena->alloc<double>(nst));
                     first = false;
                 }
-                Q[n] = mod->getInColParams()->rateMatrix(l->getEvent()->getTime(),l->getPState(),l->getUState());
+                Q[n] = mod->getInColParams()->rateMatrix(l->getEvent()->getTime(),l->getPState(),l->getUState(),arena->cleanAlloc(nst,nst));
                 break;
 
             case admission:
@@ -114,25 +154,25 @@ Markov* ConstrainedSimulator::getMarkovProcess(UnitLinkedModel *mod, infect::His
             case admission2:
                 if (first)
                 {
-                    S[n] = mod->getOutColParams()->equilibriumProbs();
+                    S[n] = mod->getOutColParams()->equilibriumProbs(arena->alloc<double>(nst));
                     first = false;
                 }
-                Q[n] = mod->getInColParams()->rateMatrix(l->getEvent()->getTime(),l->getPState(),l->getUState());
+                Q[n] = mod->getInColParams()->rateMatrix(l->getEvent()->getTime(),l->getPState(),l->getUState(),arena->cleanAlloc(nst,nst));
                 break;
 
             case postest:
             case possurvtest:
             case negtest:
             case negsurvtest:
-                S[n] =  mod->getSurveillanceTestParams()->resultProbs(l->getPState()->onAbx(),l->getEvent()->getType());
+                S[n] =  mod->getSurveillanceTestParams()->resultProbs(l->getPState()->onAbx(),l->getEvent()->getType(),arena->alloc<double>(nst));
                 break;
             case posclintest:
             case negclintest:
-                S[n] =  mod->getClinicalTestParams()->resultProbs(l->getPState()->onAbx(),l->getEvent()->getType());
+                S[n] =  mod->getClinicalTestParams()->resultProbs(l->getPState()->onAbx(),l->getEvent()->getType(),arena->alloc<double>(nst));
                 break;
 
             case discharge:
-                Q[n] = mod->getOutColParams()->rateMatrix();
+                Q[n] = mod->getOutColParams()->rateMatrix(arena->cleanAlloc(nst,nst));
                 doit[n] = false;
                 break;
 
@@ -145,12 +185,12 @@ Markov* ConstrainedSimulator::getMarkovProcess(UnitLinkedModel *mod, infect::His
             switch(l->getEvent()->getType())
             {
             case acquisition:
-                S[n] = mod->getInColParams()->acquisitionRates(l->getEvent()->getTime(),l->pPrev()->getPState(),l->uPrev()->getUState());
+                S[n] = mod->getInColParams()->acquisitionRates(l->getEvent()->getTime(),l->pPrev()->getPState(),l->uPrev()->getUState(),arena->alloc<double>(nst));
             case progression:
             case clearance:
             case admission:
             case discharge:
-                Q[n] = mod->getInColParams()->rateMatrix(l->getEvent()->getTime(),l->getPState(),l->getUState());
+                Q[n] = mod->getInColParams()->rateMatrix(l->getEvent()->getTime(),l->getPState(),l->getUState(),arena->cleanAlloc(nst,nst));
                 break;
             default:
                 continue;
@@ -164,39 +204,273 @@ Markov* ConstrainedSimulator::getMarkovProcess(UnitLinkedModel *mod, infect::His
     *mydoit = doit;
     *myS = S;
     *myQ = Q;
-    *nalloc = n;
 
-    return new Markov(mod->getNStates(),n,time,Q,S,doit,rand);
+    return n;
+}
+
+int ConstrainedSimulator::getBlocks(UnitLinkedModel *mod, int n, double *time, bool *doit, int neps, Arena *arena, int **first, int **last, int **a, int **b)
+{
+    // Each episode of the patient is a run of points ending in one, its
+    // discharge, that is not simulated through.
+    *first = arena->alloc<int>(neps);
+    *last = arena->alloc<int>(neps);
+    int c = 0;
+    for (int l=0, k=0; l<n; l=k+1, c++)
+    {
+        for (k=l; k<n-1; k++)
+            if (!doit[k])
+                break;
+        if (c < neps)
+        {
+            (*first)[c] = l;
+            (*last)[c] = k;
+        }
+    }
+
+    double window = mod->getEpisodeWindow();
+
+    if (window <= 0 || c != neps)
+    {
+        *a = arena->alloc<int>(1);
+        *b = arena->alloc<int>(1);
+        (*a)[0] = -1;
+        (*b)[0] = n;
+        return 1;
+    }
+
+    // An episode's blocks run from the previous discharge to the next
+    // admission, split at the first points past each window length.
+    *a = arena->alloc<int>(n+neps);
+    *b = arena->alloc<int>(n+neps);
+    int nb = 0;
+    for (int i=0; i<neps; i++)
+    {
+        int start = i == 0 ? -1 : (*last)[i-1];
+        double t0 = time[(*first)[i]];
+        for (int k=(*first)[i]+1; k<(*last)[i]; k++)
+        {
+            if (time[k] - t0 < window)
+                continue;
+            (*a)[nb] = start;
+            (*b)[nb] = k;
+            nb++;
+            start = k;
+            t0 = time[k];
+        }
+        (*a)[nb] = start;
+        (*b)[nb] = i == neps-1 ? n : (*first)[i+1];
+        nb++;
+    }
+
+    return nb;
+}
+
+int ConstrainedSimulator::stateAt(int m, double *times, int *states, double t)
+{
+    int s = states[0];
+    for (int j=1; j<m && times[j] <= t; j++)
+        s = states[j];
+    return s;
+}
+
+int ConstrainedSimulator::splicePath(Arena *arena, int om, double *ot, int *os, int nm, double *nt, int *ns, bool admit, double ta, double tb, double **times, int **states)
+{
+    // The fixed states at ta and tb are the same on both paths, so the
+    // pieces join up.
+    double *t = arena->alloc<double>(om+nm);
+    int *s = arena->alloc<int>(om+nm);
+
+    t[0] = ot[0];
+    s[0] = admit ? ns[0] : os[0];
+
+    int m = 1;
+    for (int j=1; j<om; j++)
+        if (ot[j] <= ta)
+        {
+            t[m] = ot[j];
+            s[m++] = os[j];
+        }
+    for (int j=1; j<nm; j++)
+        if (nt[j] > ta && nt[j] <= tb)
+        {
+            t[m] = nt[j];
+            s[m++] = ns[j];
+        }
+    for (int j=1; j<om; j++)
+        if (ot[j] > tb)
+        {
+            t[m] = ot[j];
+            s[m++] = os[j];
+        }
+
+    *times = t;
+    *states = s;
+    return m;
+}
+
+void ConstrainedSimulator::getBatches(infect::SystemHistory *h, vector< vector< vector<infect::HistoryLink *> > > &batches)
+{
+    // The first batch has one task per unit holding all the patients seen
+    // only in that unit. Patients seen in several units are a task each,
+    // put in the first later batch that uses none of their units.
+
+    batches.clear();
+    batches.push_back(vector< vector<infect::HistoryLink *> >());
+
+    map<infect::Unit *,int> unittask;
+    vector< set<infect::Unit *> > batchunits;
+
+    for (Map *p = h->getPatientHeads(); p->hasNext(); )
+    {
+        infect::HistoryLink *plink = (infect::HistoryLink *)p->nextValue();
+
+        set<infect::Unit *> units;
+        for (infect::HistoryLink *l = plink; l != 0; l = l->pNext())
+            units.insert(l->getEvent()->getUnit());
+
+        if (units.size() == 1)
+        {
+            infect::Unit *u = *units.begin();
+            if (unittask.find(u) == unittask.end())
+            {
+                unittask[u] = batches[0].size();
+                batches[0].push_back(vector<infect::HistoryLink *>());
+            }
+            batches[0][unittask[u]].push_back(plink);
+            continue;
+        }
+
+        unsigned int b = 0;
+        for ( ; b < batchunits.size(); b++)
+        {
+            bool clash = false;
+            for (set<infect::Unit *>::iterator u = units.begin(); u != units.end() && !clash; u++)
+                clash = batchunits[b].count(*u) > 0;
+            if (!clash)
+                break;
+        }
+
+        if (b == batchunits.size())
+        {
+            batchunits.push_back(set<infect::Unit *>());
+            batches.push_back(vector< vector<infect::HistoryLink *> >());
+        }
+
+        batchunits[b].insert(units.begin(),units.end());
+        batches[b+1].push_back(vector<infect::HistoryLink *>(1,plink));
+    }
+
+    // Start the busiest units first so that they do not finish last.
+    stable_sort(batches[0].begin(),batches[0].end(),
+        [](const vector<infect::HistoryLink *> &x, const vector<infect::HistoryLink *> &y)
+        {
+            return x.size() > y.size();
+        }
+    );
+}
+
+double ConstrainedSimulator::sampleBatches(UnitLinkedModel *mod, infect::SystemHistory *h, int max, Random *rand, int nthreads)
+{
+    vector< vector< vector<infect::HistoryLink *> > > batches;
+    getBatches(h,batches);
+
+    // Each task has its own stream keyed by a seed from the caller's
+    // generator, so the result does not depend on how tasks are spread
+    // over the threads.
+    uint64_t seed = ((uint64_t) (rand->runif() * 4294967296.0) << 32) | (uint64_t) (rand->runif() * 4294967296.0);
+    uint64_t stream = 0;
+    double change = 0;
+    Profile *profile = Profile::current();
+
+    for (unsigned int b = 0; b < batches.size(); b++)
+    {
+        vector< vector<infect::HistoryLink *> > &tasks = batches[b];
+        vector<double> taskchange(tasks.size(),0.0);
+
+        std::atomic<unsigned int> nexttask(0);
+        std::exception_ptr error = 0;
+        std::mutex errorlock;
+
+        auto worker = [&]()
+        {
+            Profile::current() = profile;
+            for (unsigned int i = nexttask++; i < tasks.size(); i = nexttask++)
+            {
+                try
+                {
+                    XoshiroRandom r(XoshiroRandom::streamSeed(seed, stream + i));
+                    for (unsigned int j = 0; j < tasks[i].size(); j++)
+                        taskchange[i] += sampleHistory(mod,h,tasks[i][j],max,&r);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(errorlock);
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+        };
+
+        unsigned int nt = nthreads < 1 ? 1 : nthreads;
+        if (nt > tasks.size())
+            nt = tasks.size();
+
+        vector<std::thread> pool;
+        for (unsigned int t = 1; t < nt; t++)
+            pool.push_back(std::thread(worker));
+        worker();
+        for (unsigned int t = 0; t < pool.size(); t++)
+            pool[t].join();
+
+        if (error)
+            std::rethrow_exception(error);
+
+        for (unsigned int i = 0; i < tasks.size(); i++)
+            change += taskchange[i];
+
+        stream += tasks.size();
+    }
+
+    return change;
 }
 
 // Public methods
-void ConstrainedSimulator::sampleEpisodes(UnitLinkedModel *mod, infect::SystemHistory *h, int max, Random *rand)
+double ConstrainedSimulator::sampleEpisodes(UnitLinkedModel *mod, infect::SystemHistory *h, int max, Random *rand)
 {
+    // With forward simulation augmented events are linked into the
+    // system and facility lists too, so patients are never independent.
+    if (mod->getEpisodeThreads() > 0 && !mod->isForwardEnabled())
+    {
+        return sampleBatches(mod,h,max,rand,mod->getEpisodeThreads());
+    }
+
+    double change = 0;
     for (Map *p = h->getPatientHeads(); p->hasNext(); ){
         // cout << "Sampling patient " << p->hash() << endl;
-        sampleHistory(mod,h,(infect::HistoryLink *)p->nextValue(),max,rand);
+        change += sampleHistory(mod,h,(infect::HistoryLink *)p->nextValue(),max,rand);
     }
+    return change;
 }
 
-void ConstrainedSimulator::sampleHistory(UnitLinkedModel *mod, infect::SystemHistory *hist, infect::HistoryLink *plink, int max, Random *rand)
+double ConstrainedSimulator::sampleHistory(UnitLinkedModel *mod, infect::SystemHistory *hist, infect::HistoryLink *plink, int max, Random *rand)
 {
+    // All working storage comes from a per thread arena that is reused
+    // from one patient to the next.
+    static thread_local Arena arena;
+    arena.reset();
 
     // cout << "sampleHistory()..";
     infect::Patient *pat = plink->getEvent()->getPatient();
-    int neps = 0;
-    infect::EpisodeHistory **eh = hist->getPatientHistory(pat,&neps);
+    int neps = hist->fillPatientHistory(pat,0);
+    infect::EpisodeHistory **eh = arena.alloc<infect::EpisodeHistory *>(neps);
+    hist->fillPatientHistory(pat,eh);
 
     double oldloglike = 0;
     double oldpropprob = 0;
-    double newloglike = 0;
-    double newpropprob = 0;
 
-    int *on = new int[neps];
-    int *nn = new int[neps];
-    int **os = new int*[neps];
-    int **ns = new int*[neps];
-    double **ot = new double*[neps];
-    double **nt = new double*[neps];
+    int *on = arena.alloc<int>(neps);
+    int **os = arena.alloc<int *>(neps);
+    double **ot = arena.alloc<double *>(neps);
 
     oldloglike = mod->logLikelihood(pat,plink);
     // cout << oldloglike << std::endl;
@@ -206,17 +480,17 @@ void ConstrainedSimulator::sampleHistory(UnitLinkedModel *mod, infect::SystemHis
         // cout << i << ",";
         eh[i]->unapply();
         eh[i]->installProposal();
-        getProposal(mod,eh[i],&(on[i]),&(ot[i]),&(os[i]));
+        getProposal(mod,eh[i],&arena,&(on[i]),&(ot[i]),&(os[i]));
         eh[i]->installProposal();
     }
 
-    int nalloc = 0;
     double *mytime = 0;
     double **myS = 0;
     double ***myQ = 0;
     bool *mydoit = 0;
 
-    Markov *mark = getMarkovProcess(mod,plink,rand,&nalloc,&mytime,&mydoit,&myS,&myQ);
+    int nalloc = getMarkovProcess(mod,plink,&arena,&mytime,&mydoit,&myS,&myQ);
+    Markov mark(mod->getNStates(),nalloc,mytime,myQ,myS,mydoit,rand,&arena);
 
     // Check for invalid rate matrices
     bool hasInvalidQ = false;
@@ -236,76 +510,223 @@ void ConstrainedSimulator::sampleHistory(UnitLinkedModel *mod, infect::SystemHis
         // cerr << "WARNING: Found invalid values in Q matrices\n";
     }
 
-    oldpropprob = mark->logProcessProb(neps,on,ot,os);
-    // cout << "\noldpropprob=" << oldpropprob << std::endl;
-    if(std::isnan(oldpropprob)) {
-        // cerr << "\n=== DEBUG: oldpropprob is NaN ===\n";
-        // cerr << "neps=" << neps << "\n";
-        // cerr << "nalloc=" << nalloc << "\n";
-        // for (int i = 0; i < nalloc && i < 5; i++) {
-        //     cerr << "mytime[" << i << "]=" << mytime[i] << "\n";
-        //     cerr << "mydoit[" << i << "]=" << mydoit[i] << "\n";
-        //     if (myS && myS[i]) {
-        //         cerr << "myS[" << i << "]=[";
-        //         for (int j = 0; j < mod->getNStates() && j < 5; j++) {
-        //             cerr << myS[i][j] << " ";
-        //         }
-        //         cerr << "]\n";
-        //     }
-        // }
-        throw std::runtime_error("oldpropprob is nan");
-    }
-
-    newpropprob = mark->simulateProcess(neps,nn,nt,ns);
-    // cout << "\nnewpropprob=" << newpropprob << std::endl;
-    if(std::isnan(newpropprob))
-        throw std::runtime_error("newpropprob is nan");
-
+    // The path is resampled a block at a time, holding the states at the
+    // ends of each block fixed. By default the one block is the whole
+    // path. Each proposal draws ntries candidates from the same filtered
+    // process, so the transition matrices are only worked out once.
+    int *first = 0;
+    int *last = 0;
+    int *ba = 0;
+    int *bb = 0;
+    int nblocks = getBlocks(mod,nalloc,mytime,mydoit,neps,&arena,&first,&last,&ba,&bb);
+    int ntries = mod->getEpisodeTries();
+
+    bool *applied = arena.alloc<bool>(neps);
+    bool *touched = arena.alloc<bool>(neps);
     for (int i=0; i<neps; i++)
-    {
-        putProposal(mod,eh[i],nn[i],nt[i],ns[i]);
-        eh[i]->installProposal();
-        eh[i]->apply();
-    }
+        applied[i] = false;
 
-    newloglike = mod->logLikelihood(pat,plink);
+    int **tn = arena.alloc<int *>(ntries);
+    double ***tt = arena.alloc<double **>(ntries);
+    int ***ts = arena.alloc<int **>(ntries);
+    double *tq = arena.alloc<double>(ntries);
+    double *tl = arena.alloc<double>(ntries);
+    double *tw = arena.alloc<double>(ntries);
 
-    double accept = newloglike-oldloglike;
-    double logU = 0;
-    if (!max)
-    {
-        accept += oldpropprob - newpropprob;
-        logU = log(rand->runif());
-    }
+    double loglike = oldloglike;
 
-    if (logU <= accept)
-    {
-        for (int i=0; i<neps; i++)
-            eh[i]->clearProposal();
-    }
-    else
+    for (int k=0; k<nblocks; k++)
     {
+        int a = ba[k];
+        int b = bb[k];
+        bool whole = a < 0 && b >= nalloc;
+        double ta = a < 0 ? -HUGE_VAL : mytime[a];
+        double tb = b >= nalloc ? HUGE_VAL : mytime[b];
+
+        if (!whole)
+        {
+            int sa = 0;
+            int sb = 0;
+            for (int i=0; i<neps; i++)
+            {
+                if (a >= first[i] && a <= last[i])
+                    sa = stateAt(on[i],ot[i],os[i],ta);
+                if (b >= first[i] && b <= last[i])
+                    sb = stateAt(on[i],ot[i],os[i],tb);
+            }
+            mark.condition(a,sa,b,sb);
+        }
+
         for (int i=0; i<neps; i++)
         {
-            eh[i]->unapply();
-            eh[i]->installProposal();
-            eh[i]->apply();
-            eh[i]->clearProposal();
+            touched[i] = whole || (last[i] > a && first[i] < b);
+            if (!touched[i] && !applied[i])
+            {
+                eh[i]->apply();
+                applied[i] = true;
+            }
+        }
+
+        oldpropprob = mark.logProcessProb(neps,on,ot,os);
+        if (std::isnan(oldpropprob))
+            throw std::runtime_error("oldpropprob is nan");
+
+        for (int j=0; j<ntries; j++)
+        {
+            tn[j] = arena.alloc<int>(neps);
+            tt[j] = arena.alloc<double *>(neps);
+            ts[j] = arena.alloc<int *>(neps);
+
+            tq[j] = mark.simulateProcess(neps,tn[j],tt[j],ts[j]);
+
+            if (!whole)
+            {
+                for (int i=0; i<neps; i++)
+                {
+                    if (touched[i])
+                    {
+                        tn[j][i] = splicePath(&arena,on[i],ot[i],os[i],tn[j][i],tt[j][i],ts[j][i],a < first[i],ta,tb,&tt[j][i],&ts[j][i]);
+                    }
+                    else
+                    {
+                        tn[j][i] = on[i];
+                        tt[j][i] = ot[i];
+                        ts[j][i] = os[i];
+                    }
+                }
+                tq[j] = mark.logProcessProb(neps,tn[j],tt[j],ts[j]);
+            }
+
+            if (std::isnan(tq[j]))
+                throw std::runtime_error("newpropprob is nan");
+
+            for (int i=0; i<neps; i++)
+            {
+                if (!touched[i])
+                    continue;
+                if (applied[i])
+                    eh[i]->unapply();
+                putProposal(mod,eh[i],tn[j][i],tt[j][i],ts[j][i]);
+                eh[i]->installProposal();
+                eh[i]->apply();
+                applied[i] = true;
+            }
+
+            tl[j] = mod->logLikelihood(pat,plink);
+
+            // Put back the current path to try the next candidate.
+            if (ntries > 1)
+            {
+                for (int i=0; i<neps; i++)
+                {
+                    if (!touched[i])
+                        continue;
+                    eh[i]->unapply();
+                    eh[i]->installProposal();
+                    eh[i]->clearProposal();
+                    applied[i] = false;
+                }
+            }
+        }
+
+        Profile::count(Profile::EpisodeProposals);
+
+        int pick = 0;
+        bool accepted = false;
+
+        if (ntries == 1)
+        {
+            double accept = tl[0]-loglike;
+            double logU = 0;
+            if (!max)
+            {
+                accept += oldpropprob - tq[0];
+                logU = log(rand->runif());
+            }
+            accepted = logU <= accept;
+        }
+        else if (max)
+        {
+            for (int j=1; j<ntries; j++)
+                if (tl[j] > tl[pick])
+                    pick = j;
+            accepted = tl[pick] >= loglike;
+        }
+        else
+        {
+            // Multiple-try Metropolis for independent candidates: pick one
+            // with probability proportional to its importance weight, then
+            // accept with the ratio of the total weight of the candidates
+            // to the same total with the current path in place of the pick.
+            double top = loglike - oldpropprob;
+            for (int j=0; j<ntries; j++)
+                if (tl[j]-tq[j] > top)
+                    top = tl[j]-tq[j];
+
+            if (std::isfinite(top))
+            {
+                double wy = 0;
+                for (int j=0; j<ntries; j++)
+                {
+                    tw[j] = exp(tl[j]-tq[j]-top);
+                    wy += tw[j];
+                }
+
+                pick = rand->rint(ntries,tw);
+
+                double wx = exp(loglike-oldpropprob-top);
+                for (int j=0; j<ntries; j++)
+                    if (j != pick)
+                        wx += tw[j];
+
+                accepted = log(rand->runif()) <= log(wy) - log(wx);
+            }
+        }
+
+        if (accepted)
+        {
+            Profile::count(Profile::EpisodeAccepts);
+            for (int i=0; i<neps; i++)
+            {
+                if (!touched[i])
+                    continue;
+                if (ntries > 1)
+                {
+                    putProposal(mod,eh[i],tn[pick][i],tt[pick][i],ts[pick][i]);
+                    eh[i]->installProposal();
+                    eh[i]->apply();
+                    applied[i] = true;
+                }
+                eh[i]->clearProposal();
+                on[i] = tn[pick][i];
+                ot[i] = tt[pick][i];
+                os[i] = ts[pick][i];
+            }
+            loglike = tl[pick];
+        }
+        else
+        {
+            for (int i=0; i<neps; i++)
+            {
+                if (!touched[i])
+                    continue;
+                if (ntries == 1)
+                {
+                    eh[i]->unapply();
+                    eh[i]->installProposal();
+                    eh[i]->apply();
+                    eh[i]->clearProposal();
+                }
+                else
+                {
+                    eh[i]->apply();
+                }
+                applied[i] = true;
+            }
         }
     }
 
-    cleanFree(&os,neps);
-    cleanFree(&ns,neps);
-    cleanFree(&ot,neps);
-    cleanFree(&nt,neps);
-    delete [] on;
-    delete [] nn;
-    delete [] eh;
-    delete [] mytime;
-    delete [] mydoit;
-    cleanFree(&myS,nalloc);
-    cleanFree(&myQ,nalloc,mod->getNStates());
-    delete mark;
+    return loglike - oldloglike;
 }
 
 void ConstrainedSimulator::initEpisodeHistory(UnitLinkedModel *mod, infect::EpisodeHistory *eh, bool haspostest)
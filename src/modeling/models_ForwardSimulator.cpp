@@ -1,7 +1,132 @@
 #include "modeling/modeling.h"
 
+#include <limits>
+#include <map>
+#include <vector>
+
 namespace models {
 
+namespace {
+
+// A patient in the forward simulation. The patient's next colonization
+// event runs on a unit rate clock: hazard is the event rate integrated up
+// to tlast, and the event happens when it reaches next, an Exp(1)
+// threshold. When the rate changes only the speed of the clock changes, so
+// the threshold is kept and the event time is rescaled, as in Gibson and
+// Bruck's next reaction method, and no new draw is needed.
+struct SimPatient
+{
+    infect::EpisodeHistory *episode;
+    infect::HistoryLink *last;
+    infect::Unit *unit;
+    double rate;
+    double hazard;
+    double next;
+    double tlast;
+    double time;
+
+    SimPatient() : episode(0), last(0), unit(0), rate(0), hazard(0), next(0), tlast(0), time(0) {}
+};
+
+// Indexed binary heap of the patients' event times, earliest on top, so
+// that a patient's time can be changed or the patient taken out in
+// O(log n).
+class EventQueue
+{
+private:
+    const std::vector<SimPatient> &pat;
+    std::vector<int> heap;
+    std::vector<int> pos;
+
+    inline bool before(int i, int j) const
+    {
+        return pat[heap[i]].time < pat[heap[j]].time;
+    }
+
+    inline void swap(int i, int j)
+    {
+        int x = heap[i];
+        heap[i] = heap[j];
+        heap[j] = x;
+        pos[heap[i]] = i;
+        pos[heap[j]] = j;
+    }
+
+    void up(int i)
+    {
+        while (i > 0 && before(i,(i-1)/2))
+        {
+            swap(i,(i-1)/2);
+            i = (i-1)/2;
+        }
+    }
+
+    void down(int i)
+    {
+        for (int n = heap.size(); ; )
+        {
+            int j = 2*i+1;
+            if (j >= n)
+                break;
+            if (j+1 < n && before(j+1,j))
+                j++;
+            if (!before(j,i))
+                break;
+            swap(i,j);
+            i = j;
+        }
+    }
+
+public:
+
+    EventQueue(const std::vector<SimPatient> &p) : pat(p)
+    {
+    }
+
+    inline bool empty() const
+    {
+        return heap.empty();
+    }
+
+    inline int top() const
+    {
+        return heap[0];
+    }
+
+    // Puts patient k in the queue, or moves it after its time has changed.
+    void update(int k)
+    {
+        if (k >= (int) pos.size())
+            pos.resize(k+1,-1);
+
+        if (pos[k] < 0)
+        {
+            pos[k] = heap.size();
+            heap.push_back(k);
+        }
+        up(pos[k]);
+        down(pos[k]);
+    }
+
+    void remove(int k)
+    {
+        if (k >= (int) pos.size() || pos[k] < 0)
+            return;
+
+        int i = pos[k];
+        swap(i,heap.size()-1);
+        heap.pop_back();
+        pos[k] = -1;
+        if (i < (int) heap.size())
+        {
+            up(i);
+            down(i);
+        }
+    }
+};
+
+} // namespace
+
 void ForwardSimulator::forwardSimulate(UnitLinkedModel *mod, infect::SystemHistory *hist, Random *rand)
 {
     if (!mod->isForwardEnabled())
@@ -19,6 +144,33 @@ void ForwardSimulator::forwardSimulate(UnitLinkedModel *mod, infect::SystemHisto
         map->put(a,hist->getEpisodes()->get(e));
     }
 
+    // The patients in the system, with the latest link of each patient
+    // kept as the system list is walked, so that nothing needs to be found
+    // by going back along the list. An event only changes the rates of the
+    // patients in its unit, so only those are rescheduled, with the unit
+    // state at the event's own link.
+
+    std::vector<SimPatient> pat;
+    std::map<infect::Patient *, int> slot;
+    std::map<infect::Unit *, std::vector<int> > inunit;
+    EventQueue queue(pat);
+
+    auto leaveUnit = [&](int k)
+    {
+        std::vector<int> &in = inunit[pat[k].unit];
+        for (unsigned int j=0; j<in.size(); j++)
+        {
+            if (in[j] == k)
+            {
+                in[j] = in.back();
+                in.pop_back();
+                break;
+            }
+        }
+        pat[k].unit = 0;
+        queue.remove(k);
+    };
+
     for (infect::HistoryLink *l = hist->getSystemHead(); l != 0; )
     {
         switch(l->getEvent()->getType())
@@ -47,43 +199,69 @@ void ForwardSimulator::forwardSimulate(UnitLinkedModel *mod, infect::SystemHisto
             break;
         }
 
-        if (l->sNext() == 0)
-            break;
-
-        infect::HistoryLink *phl = 0;
-        double time = l->sNext()->getEvent()->getTime();
+        double now = l->getEvent()->getTime();
+        infect::Patient *p = l->getEvent()->getPatient();
+        infect::Unit *u = l->getEvent()->getUnit();
 
-        for (Map *mp = ((infect::SetLocationState *)l->getSState())->getPatients(); mp->hasNext(); )
+        if (p != 0)
         {
-            infect::Patient *p = (infect::Patient *)mp->next();
-            infect::HistoryLink *pl = l;
-            for ( ; pl != 0; pl = pl->sPrev() )
-                if (pl->getEvent()->getPatient() == p)
-                    break;
-
-            if (pl == 0)
-                Rcpp::stop("SHOULDN'T GET HERE IN SIMULATE");
+            std::map<infect::Patient *, int>::iterator i = slot.find(p);
+            if (i == slot.end())
+            {
+                i = slot.insert(std::make_pair(p,(int)pat.size())).first;
+                pat.push_back(SimPatient());
+            }
+            int k = i->second;
+            SimPatient &s = pat[k];
 
-            infect::Unit *u = (infect::Unit *) pl->getEvent()->getUnit();
-            infect::HistoryLink *ul = l;
-            for ( ; ul != 0; ul = ul->sPrev() )
-                if (ul->getEvent()->getUnit() == u)
-                    break;
+            if (l->getEvent()->isAdmission() || l->getEvent()->isInsitu())
+            {
+                if (s.unit != 0)
+                    leaveUnit(k);
+                s.episode = getEpisodeHistory(map,l);
+                s.unit = u;
+                s.rate = 0;
+                s.hazard = 0;
+                s.next = rand->rexp();
+                s.tlast = now;
+                inunit[u].push_back(k);
+            }
+            else if (l->getEvent()->getType() == discharge && s.unit != 0)
+            {
+                leaveUnit(k);
+            }
 
-            double nexttime = randTimeToEvent(mod,l->getEvent()->getTime(),pl,ul,rand);
+            s.last = l;
+        }
 
-            if (nexttime < time)
+        if (u != 0)
+        {
+            std::vector<int> &in = inunit[u];
+            for (unsigned int j=0; j<in.size(); j++)
             {
-                time = nexttime;
-                phl = pl;
+                SimPatient &s = pat[in[j]];
+                s.hazard += s.rate * (now - s.tlast);
+                s.tlast = now;
+                s.rate = eventRate(mod,now,s.last,l);
+                s.time = now;
+                if (s.rate <= 0)
+                    s.time = std::numeric_limits<double>::infinity();
+                else if (s.next > s.hazard)
+                    s.time = now + (s.next - s.hazard) / s.rate;
+                queue.update(in[j]);
             }
         }
 
-        if (time < l->sNext()->getEvent()->getTime())
+        if (l->sNext() == 0)
+            break;
+
+        if (!queue.empty() && pat[queue.top()].time < l->sNext()->getEvent()->getTime())
         {
+            SimPatient &s = pat[queue.top()];
+            double time = s.time;
             EventCode type = nullevent;
 
-            switch(phl->getPState()->infectionStatus())
+            switch(s.last->getPState()->infectionStatus())
             {
             case uncolonized:
                 type = acquisition;
@@ -103,15 +281,20 @@ void ForwardSimulator::forwardSimulate(UnitLinkedModel *mod, infect::SystemHisto
 
             infect::HistoryLink *hl = mod->makeHistLink
             (
-                    phl->getEvent()->getFacility(),
-                    phl->getEvent()->getUnit(),
-                    phl->getEvent()->getPatient(),
+                    s.last->getEvent()->getFacility(),
+                    s.last->getEvent()->getUnit(),
+                    s.last->getEvent()->getPatient(),
                     time,
                     type,
                     1
             );
 
-            getEpisodeHistory(map,phl)->appendLink(hl);
+            // The event used up the patient's threshold, so draw the next.
+            s.hazard = s.next;
+            s.tlast = time;
+            s.next += rand->rexp();
+
+            s.episode->appendLink(hl);
             l = hl;
         }
         else
@@ -240,36 +423,24 @@ void ForwardSimulator::randTestResult(UnitLinkedModel *mod, infect::HistoryLink
     h->getEvent()->setType(tres);
 }
 
-double ForwardSimulator::randTimeToEvent(UnitLinkedModel *mod, double atime, infect::HistoryLink *ph, infect::HistoryLink *uh, Random *rand)
+double ForwardSimulator::eventRate(UnitLinkedModel *mod, double atime, infect::HistoryLink *ph, infect::HistoryLink *uh)
 {
-    double time = 0;
-
     switch(ph->getPState()->infectionStatus())
     {
     case uncolonized:
-        time = atime + rand->rexp(mod->getInColParams()->eventRate(atime,acquisition,ph->getPState(),uh->getUState()));
-        break;
+        return mod->getInColParams()->eventRate(atime,acquisition,ph->getPState(),uh->getUState());
 
     case latent:
-        time = atime + rand->rexp(mod->getInColParams()->eventRate(atime,progression,ph->getPState(),uh->getUState()));
-        break;
+        return mod->getInColParams()->eventRate(atime,progression,ph->getPState(),uh->getUState());
 
     case colonized:
-        time = atime + rand->rexp(mod->getInColParams()->eventRate(atime,clearance,ph->getPState(),uh->getUState()));
-        break;
+        return mod->getInColParams()->eventRate(atime,clearance,ph->getPState(),uh->getUState());
 
     default:
         Rcpp::stop("CAN'T GET HERE");
-    return 0;
-    break;
     }
 
-    if (time < atime)
-    {
-        Rcpp::stop("PROBLEM WITH REXP");
-    }
-
-    return time ;
+    return 0;
 }
 
 } // namespace models
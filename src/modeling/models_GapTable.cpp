@@ -0,0 +1,65 @@
+#include "modeling/modeling.h"
+
+namespace models {
+
+void GapTable::rebuild(infect::FlatHistory *f)
+{
+    prev.clear();
+    link.clear();
+    t0.clear();
+    t1.clear();
+    dt.clear();
+    tot.clear();
+    col.clear();
+    lat.clear();
+    sus.clear();
+    abxcol.clear();
+    abxlat.clear();
+    abxsus.clear();
+    evercol.clear();
+    everlat.clear();
+    eversus.clear();
+    logtot.clear();
+    logcol.clear();
+    invtot.clear();
+    hascol.clear();
+
+    for (int u=0; u<f->getNUnits(); u++)
+    {
+        for (unsigned int i=f->unitBegin(u)+1; i<f->unitEnd(u); i++)
+        {
+            int type = f->getType(i);
+            if (type == EventCoding::start || type == EventCoding::stop)
+                continue;
+
+            prev.push_back(f->getLink(i-1));
+            link.push_back(f->getLink(i));
+
+            t0.push_back(f->getTime(i-1));
+            t1.push_back(f->getTime(i));
+            dt.push_back(f->getTime(i)-f->getTime(i-1));
+
+            int n = f->getTotal(i-1);
+            int c = f->getColonized(i-1);
+            tot.push_back(n);
+            col.push_back(c);
+            lat.push_back(f->getLatent(i-1));
+            sus.push_back(f->getSusceptible(i-1));
+
+            infect::AbxLocationState *as = dynamic_cast<infect::AbxLocationState *>(f->getLink(i-1)->getUState());
+            abxcol.push_back(as == 0 ? 0 : as->getAbxColonized());
+            abxlat.push_back(as == 0 ? 0 : as->getAbxLatent());
+            abxsus.push_back(as == 0 ? 0 : as->getAbxSusceptible());
+            evercol.push_back(as == 0 ? 0 : as->getEverAbxColonized());
+            everlat.push_back(as == 0 ? 0 : as->getEverAbxLatent());
+            eversus.push_back(as == 0 ? 0 : as->getEverAbxSusceptible());
+
+            logtot.push_back(n > 0 ? log((double) n) : 0);
+            logcol.push_back(c > 0 ? log((double) c) : 0);
+            invtot.push_back(n > 0 ? 1.0/n : 0);
+            hascol.push_back(c > 0 ? 1 : 0);
+        }
+    }
+}
+
+} // namespace models
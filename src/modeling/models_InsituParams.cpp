@@ -130,10 +130,8 @@ string InsituParams::header() const
     return s.str();
 }
 
-double* InsituParams::statusProbs() const
+double* InsituParams::statusProbs(double *P) const
 {
-    double *P = new double[nstates];
-
     if (nstates == 2)
     {
         P[0] = prob(uncolonized);
@@ -171,6 +169,33 @@ void InsituParams::count(infect::HistoryLink *h)
         counts[i] += 1;
 }
 
+Parameters::Counts *InsituParams::newCounts()
+{
+    return new ArrayCounts(3);
+}
+
+void InsituParams::countInto(infect::HistoryLink *h, Counts *c)
+{
+    int i = stateIndex(h->getPState()->infectionStatus());
+    if (i >= 0)
+        ((ArrayCounts *)c)->x[i] += 1;
+}
+
+void InsituParams::addCounts(Counts *c)
+{
+    for (int i=0; i<3; i++)
+        counts[i] += ((ArrayCounts *)c)->x[i];
+}
+
+double InsituParams::countedLogLikelihood()
+{
+    double x = 0;
+    for (int i=0; i<3; i++)
+        if (counts[i] > priors[i])
+            x += (counts[i]-priors[i]) * logprobs[i];
+    return x;
+}
+
 void InsituParams::update(Random *r, bool max)
 {
     double t = 0;
@@ -218,6 +243,31 @@ void InsituParams::set(double u, double l, double c)
         logprobs[i] = log(std::max(probs[i], eps));
 }
 
+std::vector<double> InsituParams::getState() const
+{
+    return std::vector<double>(probs, probs+3);
+}
+
+void InsituParams::setState(const std::vector<double> &x)
+{
+    if (x.size() != 3)
+        throw std::runtime_error("Wrong number of values for InsituParams state");
+
+    const double eps = 1e-300;
+    for (int i=0; i<3; i++)
+    {
+        probs[i] = x[i];
+        logprobs[i] = log(std::max(probs[i], eps));
+    }
+}
+
+void InsituParams::setValues(const std::vector<double> &x)
+{
+    if ((int) x.size() != nstates)
+        throw std::runtime_error("Wrong number of values for InsituParams");
+    set(x[0], nstates == 3 ? x[1] : 0, x[nstates-1]);
+}
+
 void InsituParams::write(ostream &os) const
 {
     char *buffer = new char[100];
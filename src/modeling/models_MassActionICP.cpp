@@ -68,10 +68,8 @@ string MassActionICP::header() const
 
 // Implement InColParams.
 
-double* MassActionICP::acquisitionRates(double time, infect::PatientState *p, infect::LocationState *s)
+double* MassActionICP::acquisitionRates(double time, infect::PatientState *p, infect::LocationState *s, double *P)
 {
-    double *P = new double[nstates];
-
     if (nstates == 2)
     {
         P[0] = rates[0] * acquisitionFactor(s->getColonized(),s->getTotal());
@@ -103,9 +101,11 @@ double MassActionICP::eventRate(double time, EventCode c, infect::PatientState *
     }
 }
 
-double** MassActionICP::rateMatrix(double time, infect::PatientState *p, infect::LocationState *u)
+double** MassActionICP::rateMatrix(double time, infect::PatientState *p, infect::LocationState *u, double **Q)
 {
-    double **Q = cleanAlloc(nstates,nstates);
+    for (int i=0; i<nstates; i++)
+        for (int j=0; j<nstates; j++)
+            Q[i][j] = 0;
 
     if (nstates == 2)
     {
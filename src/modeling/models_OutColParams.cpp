@@ -164,7 +164,7 @@ void OutColParams::update(Random *r, int nsteps, int max)
         {
             oldrates[i] = rates[i];
             if (doit[i])
-                newrates[i] = exp(log(rates[i])+r->rnorm(0,1.0));
+                newrates[i] = exp(log(rates[i])+r->rnorm(0,sigmaprop));
             else
                 newrates[i] = oldrates[i];
         }
@@ -172,6 +172,10 @@ void OutColParams::update(Random *r, int nsteps, int max)
 
         f = logpost(r,max);
 
+        // All the rates move together, so aim below the one at a time rate.
+        if (adapting && !max)
+            sigmaprop = adaptScale(sigmaprop, f-oldf, 0.3, ++nadapt);
+
         if ( (max? 0 : log(r->runif())) > f-oldf)
         {
             // Reject
@@ -228,6 +232,10 @@ OutColParams::OutColParams(int nst, int nmet)
 
     doit = new int[nstates];
 
+    sigmaprop = 1.0;
+    nadapt = 0;
+    adapting = false;
+
     if (nstates == 3)
         set(1.0,1.0,1.0);
     set(0,1,1,1,1);
@@ -269,10 +277,8 @@ double OutColParams::transitionProb(InfectionStatus p, InfectionStatus c, double
     return prob(stateIndex(p),stateIndex(c),t);
 }
 
-double* OutColParams::equilibriumProbs()
+double* OutColParams::equilibriumProbs(double *p)
 {
-    double *p = new double[nstates];
-
     if (nstates == 2)
     {
         p[0] = P[0];
@@ -289,9 +295,11 @@ double* OutColParams::equilibriumProbs()
     return p;
 }
 
-double** OutColParams::rateMatrix()
+double** OutColParams::rateMatrix(double **q)
 {
-    double **q = cleanAlloc(nstates,nstates);
+    for (int i=0; i<nstates; i++)
+        for (int j=0; j<nstates; j++)
+            q[i][j] = 0;
 
     if (nstates == 2)
     {
@@ -356,6 +364,33 @@ void OutColParams::count(infect::HistoryLink *h)
             admits->add(h);
 }
 
+Parameters::Counts *OutColParams::newCounts()
+{
+    return new AdmissionCounts();
+}
+
+void OutColParams::countInto(infect::HistoryLink *h, Counts *c)
+{
+    if (countscount == 1)
+        if (h->getEvent()->isAdmission())
+            ((AdmissionCounts *)c)->admits.push_back(h);
+}
+
+void OutColParams::addCounts(Counts *c)
+{
+    std::vector<infect::HistoryLink *> &a = ((AdmissionCounts *)c)->admits;
+    for (unsigned int i=0; i<a.size(); i++)
+        admits->add(a[i]);
+}
+
+double OutColParams::countedLogLikelihood()
+{
+    double x = 0;
+    for (admits->init(); admits->hasNext(); )
+        x += logProb((infect::HistoryLink *)admits->next());
+    return x;
+}
+
 void OutColParams::update(Random *r, bool max)
 {
     update(r,nmetro,max);
@@ -456,6 +491,37 @@ std::vector<double> OutColParams::getValues() const
     return res;
 }
 
+std::vector<double> OutColParams::getState() const
+{
+    std::vector<double> x = getValues();
+    x.push_back(sigmaprop);
+    x.push_back(nadapt);
+    return x;
+}
+
+void OutColParams::setState(const std::vector<double> &x)
+{
+    if ((int) x.size() != nstates+2)
+        throw std::runtime_error("Wrong number of values for OutColParams state");
+    std::vector<double> y(x.begin(), x.begin()+nstates);
+    set(&y[0]);
+    sigmaprop = x[nstates];
+    nadapt = x[nstates+1];
+}
+
+void OutColParams::setValues(const std::vector<double> &x)
+{
+    if ((int) x.size() != nstates)
+        throw std::runtime_error("Wrong number of values for OutColParams");
+    std::vector<double> y(x);
+    set(&y[0]);
+}
+
+void OutColParams::setAdapting(bool a)
+{
+    adapting = a;
+}
+
 void OutColParams::write(ostream &os) const
 {
     char *buffer = new char[100];
@@ -70,6 +70,26 @@ double RandomTestParams::logProbGap(infect::HistoryLink *g, infect::HistoryLink
     return x;
 }
 
+double RandomTestParams::logProbGaps(const GapTable &t)
+{
+    const double *dt = t.dt.data();
+    const double *sus = t.sus.data();
+    const double *lat = t.lat.data();
+    const double *col = t.col.data();
+
+    double s = 0;
+    double l = 0;
+    double c = 0;
+    for (unsigned int i=0; i<t.size(); i++)
+    {
+        s += dt[i] * sus[i];
+        l += dt[i] * lat[i];
+        c += dt[i] * col[i];
+    }
+
+    return - s * rates[0] - l * rates[1] - c * rates[2];
+}
+
 void RandomTestParams::countGap(infect::HistoryLink *g, infect::HistoryLink *h)
 {
     double time = h->getEvent()->getTime() - g->getEvent()->getTime();
@@ -79,6 +99,53 @@ void RandomTestParams::countGap(infect::HistoryLink *g, infect::HistoryLink *h)
     ratepar[2] += time * s->getColonized();
 }
 
+// The shape and rate counts follow those kept by TestParams.
+
+Parameters::Counts *RandomTestParams::newCounts()
+{
+    return new ArrayCounts(TestParams::n*m + 2*n);
+}
+
+void RandomTestParams::countInto(infect::HistoryLink *h, Counts *c)
+{
+    TestParams::countInto(h,c);
+    ((ArrayCounts *)c)->x[TestParams::n*m + stateIndex(h->getPState()->infectionStatus())] += 1;
+}
+
+void RandomTestParams::countGapInto(infect::HistoryLink *g, infect::HistoryLink *h, Counts *c)
+{
+    double time = h->getEvent()->getTime() - g->getEvent()->getTime();
+    infect::LocationState *s = h->uPrev()->getUState();
+    double *x = ((ArrayCounts *)c)->x.data() + TestParams::n*m + n;
+    x[0] += time * s->getSusceptible();
+    x[1] += time * s->getLatent();
+    x[2] += time * s->getColonized();
+}
+
+void RandomTestParams::addCounts(Counts *c)
+{
+    TestParams::addCounts(c);
+
+    double *x = ((ArrayCounts *)c)->x.data() + TestParams::n*m;
+    for (int i=0; i<n; i++)
+    {
+        shapepar[i] += x[i];
+        ratepar[i] += x[n+i];
+    }
+}
+
+double RandomTestParams::countedLogLikelihood()
+{
+    double x = TestParams::countedLogLikelihood();
+    for (int i=0; i<n; i++)
+    {
+        if (shapepar[i] > shapeprior[i])
+            x += (shapepar[i]-shapeprior[i]) * log(rates[i]);
+        x -= (ratepar[i]-rateprior[i]) * rates[i];
+    }
+    return x;
+}
+
 void RandomTestParams::update(Random *r, bool max)
 {
     TestParams::update(r,max);
@@ -194,6 +261,37 @@ std::vector<double> RandomTestParams::getValues() const
     return res;
 }
 
+std::vector<double> RandomTestParams::getState() const
+{
+    std::vector<double> x = TestParams::getState();
+    for (int i=0; i<n; i++)
+        x.push_back(rates[i]);
+    return x;
+}
+
+void RandomTestParams::setState(const std::vector<double> &x)
+{
+    int k = TestParams::n;
+    if ((int) x.size() != k + n)
+        throw std::runtime_error("Wrong number of values for RandomTestParams state");
+
+    TestParams::setState(std::vector<double>(x.begin(), x.begin()+k));
+    for (int i=0; i<n; i++)
+        rates[i] = x[k+i];
+}
+
+void RandomTestParams::setValues(const std::vector<double> &x)
+{
+    if ((int) x.size() != 2*nstates)
+        throw std::runtime_error("Wrong number of values for RandomTestParams");
+
+    TestParams::setValues(std::vector<double>(x.begin(), x.begin()+nstates));
+    int k = nstates;
+    for (int i=0; i<n; i++)
+        if (i != 1 || nstates == 3)
+            rates[i] = x[k++];
+}
+
 void RandomTestParams::write (ostream &os) const
 {
     // Write RandomTest probabilities (not parent TestParams probabilities!)
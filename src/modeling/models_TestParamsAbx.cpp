@@ -69,10 +69,8 @@ double TestParamsAbx::eventProb(InfectionStatus s, int onabx, EventCode e) const
     return ( i < 0 || k < 0 ? 0 : probs[i][j][k] );
 }
 
-double* TestParamsAbx::resultProbs(int onabx, EventCode e) const
+double* TestParamsAbx::resultProbs(int onabx, EventCode e, double *P) const
 {
-    double *P = cleanAlloc(nstates);
-
     if (nstates == 2)
     {
         P[0] = eventProb(uncolonized,onabx,e);
@@ -99,6 +97,7 @@ double TestParamsAbx::logProb(infect::HistoryLink *const h) const
 
 void TestParamsAbx::initCounts()
 {
+    TestParams::initCounts();
     for (int i=0; i<l; i++)
         for (int j=0; j<m; j++)
             for (int k=0; k<n; k++)
@@ -113,6 +112,46 @@ void TestParamsAbx::count(infect::HistoryLink * const h)
 
     if (i >= 0 && k >= 0)
         counts[i][j][k] += 1;
+
+    TestParams::count(h);
+}
+
+// The counts follow those kept by TestParams.
+
+Parameters::Counts *TestParamsAbx::newCounts()
+{
+    return new ArrayCounts(TestParams::n*TestParams::m + l*m*n);
+}
+
+void TestParamsAbx::countInto(infect::HistoryLink *h, Counts *c)
+{
+    int i = stateIndex(h->getPState()->infectionStatus());
+    int j = ( useabx && h->getPState()->onAbx() ? 1 : 0) ;
+    int k = testResultIndex(h->getEvent()->getType());
+
+    if (i >= 0 && k >= 0)
+        ((ArrayCounts *)c)->x[TestParams::n*TestParams::m + (i*m+j)*n+k] += 1;
+
+    TestParams::countInto(h,c);
+}
+
+void TestParamsAbx::addCounts(Counts *c)
+{
+    TestParams::addCounts(c);
+
+    double *x = ((ArrayCounts *)c)->x.data() + TestParams::n*TestParams::m;
+    for (int i=0; i<l; i++)
+        for (int j=0; j<m; j++)
+            for (int k=0; k<n; k++)
+                counts[i][j][k] += x[(i*m+j)*n+k];
+}
+
+// logProb() above is const so does not override Parameters::logProb(),
+// and the model's likelihood uses TestParams::logProb(). The matching
+// counts are the ones kept by TestParams.
+double TestParamsAbx::countedLogLikelihood()
+{
+    return TestParams::countedLogLikelihood();
 }
 
 void TestParamsAbx::update(Random *r, bool max)
@@ -172,6 +211,38 @@ int TestParamsAbx::nParam() const
 }
 
 
+std::vector<double> TestParamsAbx::getState() const
+{
+    std::vector<double> x = TestParams::getState();
+    for (int i=0; i<l; i++)
+        for (int j=0; j<m; j++)
+            x.push_back(probs[i][j][1]);
+    return x;
+}
+
+void TestParamsAbx::setState(const std::vector<double> &x)
+{
+    int k = TestParams::n;
+    if ((int) x.size() != k + l*m)
+        throw std::runtime_error("Wrong number of values for TestParamsAbx state");
+
+    TestParams::setState(std::vector<double>(x.begin(), x.begin()+k));
+    for (int i=0; i<l; i++)
+        for (int j=0; j<m; j++)
+            set(i,j,x[k++]);
+}
+
+void TestParamsAbx::setValues(const std::vector<double> &x)
+{
+    if ((int) x.size() != 2*nstates)
+        throw std::runtime_error("Wrong number of values for TestParamsAbx");
+    int k = 0;
+    for (int j=0; j<m; j++)
+        for (int i=0; i<l; i++)
+            if (i != 1 || nstates == 3)
+                set(i,j,x[k++]);
+}
+
 void TestParamsAbx::write (ostream &os) const
 {
     char *buffer = new char[100];
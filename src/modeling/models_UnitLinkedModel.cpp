@@ -1,7 +1,28 @@
 #include "modeling/modeling.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 namespace models {
 
+// Counts h into p's own counts, or into c[k] if there are separate counts.
+
+static inline void countEvent(Parameters *p, infect::HistoryLink *h, Parameters::Counts **c, int k)
+{
+    if (c == 0)
+        p->count(h);
+    else
+        p->countInto(h,c[k]);
+}
+
+static inline void countGap(Parameters *p, infect::HistoryLink *g, infect::HistoryLink *h, Parameters::Counts **c, int k)
+{
+    if (c == 0)
+        p->countGap(g,h);
+    else
+        p->countGapInto(g,h,c[k]);
+}
+
 UnitLinkedModel::UnitLinkedModel(int ns, int fw, int ch)
 {
     setAbxLife(1.5);
@@ -9,6 +30,16 @@ UnitLinkedModel::UnitLinkedModel(int ns, int fw, int ch)
     nstates = ns;
     forwardEnabled = fw;
     cheating = ch;
+    episodeThreads = 0;
+    unitThreads = 0;
+    episodeTries = 1;
+    episodeWindow = 0;
+    adaptive = false;
+    columnar = false;
+    gapversion = 0;
+    loglik = 0;
+    loglikvalid = false;
+    counthidden = false;
 
     isp = 0;
     ocp = 0;
@@ -21,6 +52,25 @@ UnitLinkedModel::UnitLinkedModel(int ns, int fw, int ch)
 double UnitLinkedModel::logLikelihood(infect::SystemHistory *hist)
 {
     // cout << "UnitLinkedModel::logLikelihood(infect::SystemHistory *hist=" << hist << ")\n";
+    if (unitThreads > 0)
+    {
+        std::vector<infect::HistoryLink *> heads;
+        for (Map *h = hist->getUnitHeads(); h->hasNext(); )
+            heads.push_back((infect::HistoryLink *) h->nextValue());
+
+        std::vector<double> utot(heads.size(),0.0);
+        forEachUnit(heads.size(),[&](int u)
+        {
+            for (infect::HistoryLink *l = heads[u]; l != 0; l=l->uNext())
+                utot[u] += logLikelihood(l);
+        });
+
+        double xtot = 0;
+        for (unsigned int u=0; u<utot.size(); u++)
+            xtot += utot[u];
+        return xtot;
+    }
+
     double xtot = 0;
     for (Map *h = hist->getUnitHeads(); h->hasNext(); )
     {
@@ -37,6 +87,135 @@ double UnitLinkedModel::logLikelihood(infect::SystemHistory *hist)
     return xtot;
 }
 
+double UnitLinkedModel::logLikelihood(infect::FlatHistory *f)
+{
+    if (!columnar)
+        return logLikelihood(f->getSystemHistory());
+
+    if (gapversion != f->getVersion())
+    {
+        gaps.rebuild(f);
+        gapversion = f->getVersion();
+    }
+
+    double x = 0;
+    x += icp->logProbGaps(gaps);
+    x += survtsp->logProbGaps(gaps);
+    if (clintsp && clintsp != survtsp)
+        x += clintsp->logProbGaps(gaps);
+    if (abxp != 0)
+        x += abxp->logProbGaps(gaps);
+
+    for (unsigned int i=0; i<f->size(); i++)
+        x += logLikelihood(f->getLink(i),0);
+    return x;
+}
+
+void UnitLinkedModel::forEachUnit(int n, const std::function<void(int)> &f)
+{
+    std::atomic<int> nextunit(0);
+    std::exception_ptr error = 0;
+    std::mutex errorlock;
+    Profile *profile = Profile::current();
+
+    auto worker = [&]()
+    {
+        Profile::current() = profile;
+        for (int u = nextunit++; u < n; u = nextunit++)
+        {
+            try
+            {
+                f(u);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(errorlock);
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+    };
+
+    int nt = unitThreads < 1 ? 1 : unitThreads;
+    if (nt > n)
+        nt = n;
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < nt; t++)
+        pool.push_back(std::thread(worker));
+    worker();
+    for (unsigned int t = 0; t < pool.size(); t++)
+        pool[t].join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+bool UnitLinkedModel::countUnitStats(const std::vector<infect::HistoryLink *> &heads)
+{
+    Parameters *p[ncounts] = {isp, ocp, survtsp, clintsp != survtsp ? clintsp : 0, icp, abxp};
+
+    for (int k=0; k<ncounts; k++)
+    {
+        if (p[k] == 0)
+            continue;
+        Parameters::Counts *c = p[k]->newCounts();
+        if (c == 0)
+            return false;
+        delete c;
+    }
+
+    int n = heads.size();
+    std::vector<Parameters::Counts *> counts(n*ncounts,(Parameters::Counts *)0);
+    std::vector<infect::HistoryLink *> tails(n,(infect::HistoryLink *)0);
+
+    try
+    {
+        forEachUnit(n,[&](int u)
+        {
+            Parameters::Counts **c = &counts[u*ncounts];
+            for (int k=0; k<ncounts; k++)
+                if (p[k] != 0)
+                    c[k] = p[k]->newCounts();
+
+            infect::HistoryLink *prev = heads[u];
+            for (infect::HistoryLink *h = prev->uNext(); h != 0; h = h->uNext())
+            {
+                countGapStats(prev,h,c);
+                if (h->isHidden())
+                    return;
+                countEventStats(h,c);
+                prev = h;
+            }
+            tails[u] = prev;
+        });
+    }
+    catch (...)
+    {
+        for (unsigned int i=0; i<counts.size(); i++)
+            delete counts[i];
+        throw;
+    }
+
+    for (int u=0; u<n; u++)
+    {
+        for (int k=0; k<ncounts; k++)
+        {
+            if (p[k] == 0)
+                continue;
+            p[k]->addCounts(counts[u*ncounts+k]);
+            delete counts[u*ncounts+k];
+        }
+
+        if (tails[u] == 0)
+            counthidden = true;
+        else
+            unittails.push_back(tails[u]);
+    }
+
+    return true;
+}
+
 infect::HistoryLink* UnitLinkedModel::makeHistLink(infect::Facility *f, infect::Unit *u, infect::Patient *p, double time, EventCode type, int linked)
 {
     return new infect::HistoryLink
@@ -140,71 +319,96 @@ void UnitLinkedModel::countUnitStats(infect::HistoryLink *l)
 
     for (infect::HistoryLink *h = l->uNext() ; h != 0; h = h->uNext())
     {
-        icp->countGap(prev,h);
-        survtsp->countGap(prev,h);
-        if (clintsp && clintsp != survtsp)
-            clintsp->countGap(prev,h);
-        if (abxp != 0)
-            abxp->countGap(prev,h);
+        countGapStats(prev,h);
 
         if (h->isHidden())
-            break;
-
-        switch(h->getEvent()->getType())
         {
-        case insitu:
-        case insitu0:
-        case insitu1:
-        case insitu2:
-            isp->count(h);
+            counthidden = true;
             break;
+        }
 
-        case admission:
-        case admission0:
-        case admission1:
-        case admission2:
-            ocp->count(h);
-            break;
+        countEventStats(h);
 
-        case negsurvtest:
-        case possurvtest:
-            survtsp->count(h);
-            break;
+        prev = h;
+    }
 
-        case negclintest:
-        case posclintest:
-            if (clintsp)
-                clintsp->count(h);
-            break;
+    unittails.push_back(prev);
+}
 
-        case acquisition:
-        case progression:
-        case clearance:
-            icp->count(h);
-            break;
+void UnitLinkedModel::countGapStats(infect::HistoryLink *prev, infect::HistoryLink *h)
+{
+    countGapStats(prev,h,0);
+}
 
-        case abxon:
-            if (abxp != 0)
-                abxp->count(h);
-            break;
+void UnitLinkedModel::countGapStats(infect::HistoryLink *prev, infect::HistoryLink *h, Parameters::Counts **c)
+{
+    countGap(icp,prev,h,c,cicp);
+    countGap(survtsp,prev,h,c,csurv);
+    if (clintsp && clintsp != survtsp)
+        countGap(clintsp,prev,h,c,cclin);
+    if (abxp != 0)
+        countGap(abxp,prev,h,c,cabx);
+}
 
-        case abxdose:
-        case abxoff:
-        case discharge:
-        case marker:
-        case start:
-        case stop:
-        case isolon:
-        case isoloff:
-            break;
+void UnitLinkedModel::countEventStats(infect::HistoryLink *h)
+{
+    countEventStats(h,0);
+}
 
-        default:
-            throw std::runtime_error("Event not handled.");
-        // cerr << "Event not handled " << h->getEvent() << "\n";
+void UnitLinkedModel::countEventStats(infect::HistoryLink *h, Parameters::Counts **c)
+{
+    switch(h->getEvent()->getType())
+    {
+    case insitu:
+    case insitu0:
+    case insitu1:
+    case insitu2:
+        countEvent(isp,h,c,cisp);
         break;
-        }
 
-        prev = h;
+    case admission:
+    case admission0:
+    case admission1:
+    case admission2:
+        countEvent(ocp,h,c,cocp);
+        break;
+
+    case negsurvtest:
+    case possurvtest:
+        countEvent(survtsp,h,c,csurv);
+        break;
+
+    case negclintest:
+    case posclintest:
+        if (clintsp)
+            countEvent(clintsp,h,c,clintsp == survtsp ? csurv : cclin);
+        break;
+
+    case acquisition:
+    case progression:
+    case clearance:
+        countEvent(icp,h,c,cicp);
+        break;
+
+    case abxon:
+        if (abxp != 0)
+            countEvent(abxp,h,c,cabx);
+        break;
+
+    case abxdose:
+    case abxoff:
+    case discharge:
+    case marker:
+    case start:
+    case stop:
+    case isolon:
+    case isoloff:
+        break;
+
+    default:
+        throw std::runtime_error("Event not handled.");
+    // cerr << "Event not handled " << h->getEvent() << "\n";
+    break;
     }
 }
 
@@ -370,6 +574,80 @@ void UnitLinkedModel::update(infect::SystemHistory *hist, Random *r)
 
 void UnitLinkedModel::update(infect::SystemHistory *hist, Random *r, int max)
 {
+    initParameterCounts();
+
+    std::vector<infect::HistoryLink *> heads;
+    if (unitThreads > 0)
+        for (Map *h = hist->getUnitHeads(); h->hasNext(); )
+            heads.push_back((infect::HistoryLink *) h->nextValue());
+
+    if (unitThreads == 0 || !countUnitStats(heads))
+        for (Map *h = hist->getUnitHeads(); h->hasNext(); )
+            countUnitStats((infect::HistoryLink *)h->nextValue());
+
+    updateParameters(r,max);
+    countLogLikelihood();
+}
+
+void UnitLinkedModel::countLogLikelihood()
+{
+    loglikvalid = false;
+
+    // The likelihood of a unit stops before a hidden link, so the counts
+    // don't cover it.
+    if (counthidden)
+        return;
+
+    double x = 0;
+    x += isp->countedLogLikelihood();
+    x += ocp->countedLogLikelihood();
+    x += icp->countedLogLikelihood();
+    x += survtsp->countedLogLikelihood();
+    if (clintsp && clintsp != survtsp)
+        x += clintsp->countedLogLikelihood();
+    if (abxp != 0)
+        x += abxp->countedLogLikelihood();
+
+    // The gaps before the units' stop events are counted but are not part
+    // of logLikelihood().
+    for (unsigned int i=0; i<unittails.size(); i++)
+    {
+        infect::HistoryLink *h = unittails[i];
+        if (h->getEvent()->getType() != stop || h->uPrev() == 0)
+            continue;
+        x -= icp->logProbGap(h->uPrev(),h);
+        x -= survtsp->logProbGap(h->uPrev(),h);
+        if (clintsp && clintsp != survtsp)
+            x -= clintsp->logProbGap(h->uPrev(),h);
+        if (abxp != 0)
+            x -= abxp->logProbGap(h->uPrev(),h);
+    }
+
+    if (std::isnan(x))
+        return;
+
+    loglik = x;
+    loglikvalid = true;
+}
+
+bool UnitLinkedModel::runningLogLikelihood(double *x)
+{
+    if (!loglikvalid)
+        return false;
+    *x = loglik;
+    return true;
+}
+
+void UnitLinkedModel::resetLogLikelihood()
+{
+    loglikvalid = false;
+}
+
+void UnitLinkedModel::initParameterCounts()
+{
+    counthidden = false;
+    unittails.clear();
+
     isp->initCounts();
     survtsp->initCounts();
     if (clintsp && clintsp != survtsp)
@@ -378,18 +656,49 @@ void UnitLinkedModel::update(infect::SystemHistory *hist, Random *r, int max)
     ocp->initCounts();
     if (abxp != 0)
         abxp->initCounts();
+}
 
-    for (Map *h = hist->getUnitHeads(); h->hasNext(); )
-        countUnitStats((infect::HistoryLink *)h->nextValue());
+void UnitLinkedModel::setAdapting(bool a)
+{
+    a = a && adaptive;
+    isp->setAdapting(a);
+    ocp->setAdapting(a);
+    survtsp->setAdapting(a);
+    if (clintsp && clintsp != survtsp)
+        clintsp->setAdapting(a);
+    icp->setAdapting(a);
+    if (abxp != 0)
+        abxp->setAdapting(a);
+}
 
-    isp->update(r,max);
-    icp->update(r,max);
-    survtsp->update(r,max);
+void UnitLinkedModel::updateParameters(Random *r, int max)
+{
+    {
+        Profile::Scope timer(Profile::UpdateInsitu);
+        isp->update(r,max);
+    }
+    {
+        Profile::Scope timer(Profile::UpdateInCol);
+        icp->update(r,max);
+    }
+    {
+        Profile::Scope timer(Profile::UpdateSurveillanceTest);
+        survtsp->update(r,max);
+    }
     if (clintsp && clintsp != survtsp)
+    {
+        Profile::Scope timer(Profile::UpdateClinicalTest);
         clintsp->update(r,max);
-    ocp->update(r,max);
+    }
+    {
+        Profile::Scope timer(Profile::UpdateOutCol);
+        ocp->update(r,max);
+    }
     if (abxp != 0)
+    {
+        Profile::Scope timer(Profile::UpdateAbx);
         abxp->update(r,max);
+    }
 }
 
 std::vector<double> UnitLinkedModel::getHistoryLinkLogLikelihoods(infect::SystemHistory *hist)
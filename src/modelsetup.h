@@ -242,10 +242,55 @@ inline void setupLinearAbxAcquisitionModel(
 }
 
 
+// The census and colonized count powers are not log transformed, so they
+// get a Gaussian prior with the weight as its precision.
+inline void setNormalParam(LogNormalICP* icp, int i, int j, Rcpp::List Param)
+{
+    double weight = Rcpp::as<double>(Param["weight"]);
+    icp->setNormal(i, j,
+                   Rcpp::as<double>(Param["init"]),
+                   Rcpp::as<bool>(Param["update"]),
+                   Rcpp::as<double>(Param["prior"]),
+                   weight > 0 ? 1/weight : 1);
+}
+
+inline void setupMultiUnitAbxAcquisition(
+        MultiUnitAbxICP* icp,
+        Rcpp::List AcquisitionParams
+)
+{
+    setParam(icp, 0, 0, AcquisitionParams["time"]);
+    setNormalParam(icp, 0, 2, AcquisitionParams["ltot"]);
+    setNormalParam(icp, 0, 3, AcquisitionParams["lcol"]);
+    setParam(icp, 0, 4, AcquisitionParams["col"]);
+    setParam(icp, 0, 5, AcquisitionParams["col_abx"]);
+    setParam(icp, 0, 6, AcquisitionParams["suss_abx"]);
+    setParam(icp, 0, 7, AcquisitionParams["suss_ever"]);
+
+    // Either one Param for every unit, or one per unit in index order.
+    Rcpp::List unit = AcquisitionParams["unit"];
+    if (!unit.containsElementNamed("init") && unit.size() != icp->nUnits())
+        Rcpp::stop("unit must be a Param or a list of %d Params, one per unit", icp->nUnits());
+    for (int i=0; i < icp->nUnits(); i++)
+    {
+        Rcpp::List p = unit.containsElementNamed("init") ? unit : Rcpp::as<Rcpp::List>(unit[i]);
+        icp->setUnit(i,
+                     Rcpp::as<double>(p["init"]),
+                     Rcpp::as<bool>(p["update"]),
+                     Rcpp::as<double>(p["prior"]),
+                     Rcpp::as<double>(p["weight"]));
+    }
+}
+
 inline void setupAcquisitionParams(
         LogNormalICP * icp,
         Rcpp::List AcquisitionParams
 ){
+    MultiUnitAbxICP* mu = dynamic_cast<MultiUnitAbxICP*>(icp);
+    if (mu != nullptr) {
+        setupMultiUnitAbxAcquisition(mu, AcquisitionParams);
+        return;
+    }
     setupLogNormalICPAcquisition(icp, AcquisitionParams);
 }
 
@@ -1,5 +1,8 @@
 
 #include <string>
+#include <memory>
+#include <climits>
+#include <cmath>
 using std::string;
 
 #include "util/util.h"
@@ -16,11 +19,15 @@ using namespace lognormal;
 using namespace Rcpp;
 
 #include "RRandom.h"
+#include "MCMCChain.h"
+#include "Checkpoint.h"
+#include "Predictive.h"
 
 #include "modelsetup.h"
 lognormal::LogNormalModel* newModel(
         Rcpp::List modelParameters, //< Model specific options.
-        bool verbose = false)
+        bool verbose = false,
+        System *sys = 0) //< Data, for models with per unit parameters.
 {
     lognormal::LogNormalModel *model = 0;
     std::string modname = modelParameters["modname"];
@@ -46,10 +53,22 @@ lognormal::LogNormalModel* newModel(
         );
         modelsetup<LinearAbxModel2>((LinearAbxModel2*)model, modelParameters, verbose);
     } else
-    // if (modname == "MultiUnitLinearAbxModel")
-    // {
-    //     model = new lognormal::MultiUnitLinearAbxModel(nstates,l,nmetro,forward,cheat);
-    // } else
+    if (modname == "MultiUnitAbxModel")
+    {
+        if (sys == 0)
+            throw std::invalid_argument("MultiUnitAbxModel needs the data to find its units");
+        util::List *units = sys->getUnits();
+        model = new LogNormalModel(
+            units,
+            nstates,
+            1,
+            modelParameters["nmetro"],
+            modelParameters["forward"],
+            modelParameters["cheat"]
+        );
+        delete units;
+        modelsetup<LogNormalModel>(model, modelParameters, verbose);
+    } else
     if (modname == "MixedModel")
     {
         model = new MixedModel(
@@ -83,6 +102,21 @@ lognormal::LogNormalModel* newModel(
         throw std::invalid_argument("Invalid model name");
     }
 
+    // Parameter lists made before these options were added don't have
+    // them.
+    if (modelParameters.containsElementNamed("adapt"))
+        model->setAdaptive(Rcpp::as<bool>(modelParameters["adapt"]));
+    if (modelParameters.containsElementNamed("block"))
+        ((LogNormalICP *) model->getInColParams())->setBlockUpdate(Rcpp::as<bool>(modelParameters["block"]));
+    if (modelParameters.containsElementNamed("hmc"))
+        ((LogNormalICP *) model->getInColParams())->setHMC(Rcpp::as<bool>(modelParameters["hmc"]));
+    if (modelParameters.containsElementNamed("ntries"))
+        model->setEpisodeTries(Rcpp::as<int>(modelParameters["ntries"]));
+    if (modelParameters.containsElementNamed("window"))
+        model->setEpisodeWindow(Rcpp::as<double>(modelParameters["window"]));
+    if (modelParameters.containsElementNamed("columnar"))
+        model->setColumnar(Rcpp::as<bool>(modelParameters["columnar"]));
+
     //model->setup(modOptions);
     //modelsetup(model, modelParameters, verbose);
 
@@ -90,52 +124,311 @@ lognormal::LogNormalModel* newModel(
 }
 
 
-//' Run Bayesian Transmission MCMC
-//'
-//' @param data Data frame with columns, in order: facility, unit, time, patient, and event type.
-//' @param modelParameters List of model parameters, see <LogNormalModelParams>.
-//' @param nsims Number of MCMC samples to collect after burn-in.
-//' @param nburn Number of burn-in iterations.
-//' @param outputparam Whether to output parameter values at each iteration.
-//' @param outputfinal Whether to output the final model state.
-//' @param verbose Print progress messages.
-//'
-//' @return A list with the following elements:
-//'   * `Parameters` the MCMC chain of model parameters (if outputparam=TRUE)
-//'   * `LogLikelihood` the log likelihood of the model at each iteration (if outputparam=TRUE)
-//'   * `MCMCParameters` the MCMC parameters used
-//'   * `ModelParameters` the model parameters used
-//'   * `ModelName` the name of the model
-//'   * `nstates` the number of states in the model
-//'   * `waic1` the WAIC1 estimate
-//'   * `waic2` the WAIC2 estimate
-//'   * and optionally (if outputfinal=TRUE) `FinalModel` the final model state.
-//' @examples
-//' \dontrun{
-//'   # Minimal example: create parameters and run a very short MCMC
-//'   params <- LinearAbxModel(nstates = 2)
-//'   data(simulated.data_sorted, package = "bayestransmission")
-//'   results <- runMCMC(
-//'     data = simulated.data_sorted,
-//'     modelParameters = params,
-//'     nsims = 1,
-//'     nburn = 0,
-//'     outputparam = TRUE,
-//'     outputfinal = FALSE,
-//'     verbose = FALSE
-//'   )
-//'   str(results)
-//' }
-//' @export
-// [[Rcpp::export]]
-SEXP runMCMC(
+// Data must be sorted by patient, then time.
+void checkSorted(const std::vector<int> &patients, const std::vector<double> &times)
+{
+    for (size_t i = 1; i < patients.size(); i++) {
+        if (patients[i] < patients[i-1]) {
+            Rcpp::stop("Data must be sorted by patient ID, then time. "
+                      "Row %d has patient %d, but previous row had patient %d. "
+                      "Please sort your data: data[order(data$patient, data$time), ]",
+                      i+1, patients[i], patients[i-1]);
+        }
+        if (patients[i] == patients[i-1] && times[i] < times[i-1]) {
+            Rcpp::stop("Data must be sorted by patient ID, then time. "
+                      "For patient %d, row %d has time %.4f which is before row %d time %.4f. "
+                      "Please sort your data: data[order(data$patient, data$time), ]",
+                      patients[i], i+1, times[i], i, times[i-1]);
+        }
+    }
+}
+
+// Trace file paths from the outputfile argument, one per chain.
+std::vector<std::string> traceFiles(Rcpp::Nullable<Rcpp::CharacterVector> outputfile, unsigned int nchains)
+{
+    std::vector<std::string> tracefiles;
+    if (outputfile.isNotNull())
+    {
+        tracefiles = Rcpp::as< std::vector<std::string> >(outputfile);
+        if (tracefiles.size() != nchains)
+            Rcpp::stop("outputfile must give one path per chain");
+    }
+    return tracefiles;
+}
+
+// Master seed for the chain random number streams. If none is given it is
+// drawn from R's generator, so set.seed() still gives reproducible runs.
+// Seeds are returned to R as doubles, so they are kept below 2^53, where a
+// double holds every whole number exactly.
+uint64_t masterSeed(Rcpp::Nullable<double> seed)
+{
+    if (seed.isNotNull())
+    {
+        double x = Rcpp::as<double>(seed);
+        if (!std::isfinite(x) || x < 0 || x != std::floor(x) || x >= 9007199254740992.0)
+            Rcpp::stop("seed must be a whole number from 0 to 2^53 - 1");
+        return (uint64_t) x;
+    }
+
+    Rcpp::NumericVector u = Rcpp::runif(2);
+    return ((uint64_t) (u[0] * 2097152.0) << 32) | (uint64_t) (u[1] * 4294967296.0);
+}
+
+// Checkpoint settings for each chain from the checkpoint arguments. The
+// model parameters are kept in the checkpoints, serialized, so that
+// resumeMCMC() can make the models again, and so is the master seed, so
+// that it can report it.
+std::vector<ChainCheckpoint> chainCheckpoints(
+    Rcpp::Nullable<Rcpp::CharacterVector> checkpoint,
+    unsigned int every,
+    unsigned int nchains,
+    Rcpp::List modelParameters,
+    uint64_t master
+) {
+    std::vector<ChainCheckpoint> checkpoints;
+    if (checkpoint.isNull())
+        return checkpoints;
+
+    std::vector<std::string> paths = Rcpp::as< std::vector<std::string> >(checkpoint);
+    if (paths.size() != nchains)
+        Rcpp::stop("checkpoint must give one path per chain");
+
+    Rcpp::Function serialize("serialize");
+    Rcpp::RawVector setup = serialize(modelParameters, R_NilValue);
+
+    checkpoints.resize(nchains);
+    for (unsigned int c=0; c<nchains; c++)
+    {
+        checkpoints[c].path = paths[c];
+        checkpoints[c].every = every;
+        checkpoints[c].setup.assign(setup.begin(), setup.end());
+        checkpoints[c].seed = master;
+    }
+    return checkpoints;
+}
+
+// The sampler profiles of the chains as a data frame, one row per chain
+// and timer, counter, or updated in unit parameter.
+Rcpp::DataFrame profileFrame(const std::vector< std::vector<ProfileRow> > &profiles)
+{
+    std::vector<int> chain;
+    std::vector<std::string> name;
+    std::vector<double> calls;
+    std::vector<double> seconds;
+    std::vector<double> accepted;
+    std::vector<double> rate;
+
+    for (unsigned int c=0; c<profiles.size(); c++)
+    {
+        for (unsigned int i=0; i<profiles[c].size(); i++)
+        {
+            const ProfileRow &r = profiles[c][i];
+            chain.push_back(c+1);
+            name.push_back(r.name);
+            calls.push_back(r.calls);
+            seconds.push_back(r.seconds);
+            accepted.push_back(r.accepted);
+            rate.push_back(r.calls > 0 ? r.accepted / r.calls : NA_REAL);
+        }
+    }
+
+    return Rcpp::DataFrame::create(
+        _["chain"] = chain,
+        _["name"] = name,
+        _["calls"] = calls,
+        _["seconds"] = seconds,
+        _["accepted"] = accepted,
+        _["rate"] = rate,
+        _["stringsAsFactors"] = false
+    );
+}
+
+// Adds to ret the WAIC of the chains' draws pooled, as waic, its terms for
+// each test, as Pointwise, and the kept log probabilities of the tests, if
+// any, as PointwiseLogLik, one row per kept draw chain by chain.
+void waicOutput(Rcpp::List &ret, const std::vector<const PointwiseWAIC *> &waics, const std::vector<double> &time, const std::vector<int> &patient, unsigned int loothin)
+{
+    PointwiseWAIC w(waics[0]->tests());
+    for (unsigned int c=0; c<waics.size(); c++)
+        w.merge(*waics[c]);
+
+    unsigned int m = w.tests();
+    Rcpp::NumericVector lppd(m);
+    Rcpp::NumericVector pwaic(m);
+    for (unsigned int j=0; j<m; j++)
+    {
+        lppd(j) = w.lppd(j);
+        pwaic(j) = w.pwaic(j);
+    }
+
+    ret["waic"] = w.waic();
+    ret["Pointwise"] = Rcpp::DataFrame::create(
+        _["patient"] = patient,
+        _["time"] = time,
+        _["lppd"] = lppd,
+        _["p_waic"] = pwaic
+    );
+
+    if (loothin > 0)
+    {
+        const std::vector<float> &d = w.keptDraws();
+        unsigned int ndraws = m > 0 ? d.size() / m : 0;
+        Rcpp::NumericMatrix ll(ndraws, m);
+        for (unsigned int i=0; i<ndraws; i++)
+            for (unsigned int j=0; j<m; j++)
+                ll(i,j) = d[(size_t) i * m + j];
+        ret["PointwiseLogLik"] = ll;
+    }
+}
+
+// Multi-chain version of runMCMC.
+// Models are made here on the main thread, as reading modelParameters uses
+// the R API. Everything else, including building each chain's System and
+// SystemHistory, happens on the pool threads in runChains().
+SEXP runMCMCChains(
     Rcpp::DataFrame data,
     Rcpp::List modelParameters,
     unsigned int nsims,
-    unsigned int nburn = 100,
-    bool outputparam = true,
-    bool outputfinal = false,
-    bool verbose = false
+    unsigned int nburn,
+    bool outputparam,
+    bool outputfinal,
+    bool verbose,
+    unsigned int nchains,
+    unsigned int nthreads,
+    uint64_t master,
+    const std::vector<std::string> &tracefiles,
+    const std::vector<ChainCheckpoint> &checkpoints,
+    bool profile,
+    unsigned int loothin
+) {
+    ChainData cd;
+    cd.facilities = as<std::vector<int>>(data[0]);
+    cd.units = as<std::vector<int>>(data[1]);
+    cd.times = as<std::vector<double>>(data[2]);
+    cd.patients = as<std::vector<int>>(data[3]);
+    cd.types = as<std::vector<int>>(data[4]);
+    checkSorted(cd.patients, cd.times);
+
+    if (verbose) Rcpp::Rcout << "Creating " << nchains << " models...";
+    // Models with per unit parameters are sized from the units in the
+    // data. Each chain's own System gives its units the same indexes.
+    // If one of the models can't be made those already made are freed.
+    System *sys = 0;
+    std::vector<lognormal::LogNormalModel *> models;
+    try
+    {
+        if (Rcpp::as<std::string>(modelParameters["modname"]) == "MultiUnitAbxModel")
+            sys = new System(cd.facilities, cd.units, cd.times, cd.patients, cd.types);
+        for (unsigned int i=0; i<nchains; i++)
+            models.push_back(newModel(modelParameters, false, sys));
+    }
+    catch (...)
+    {
+        if (sys != 0)
+            delete sys;
+        for (unsigned int i=0; i<models.size(); i++)
+            delete models[i];
+        throw;
+    }
+    if (sys != 0)
+        delete sys;
+    if (verbose) Rcpp::Rcout << "Done" << std::endl;
+
+    if (verbose) Rcpp::Rcout << "Running " << nchains << " chains...";
+    std::vector<ChainResult> res;
+    runChains(cd, models, master, nthreads, nsims, nburn, outputparam, outputfinal, res, tracefiles, checkpoints, profile, loothin);
+    if (verbose) Rcpp::Rcout << "Done" << std::endl;
+
+    for (unsigned int c=0; c<nchains; c++)
+    {
+        if (res[c].error != "")
+        {
+            for (unsigned int i=0; i<nchains; i++)
+                delete models[i];
+            Rcpp::stop("Chain %d failed: %s", c+1, res[c].error);
+        }
+    }
+
+    Rcpp::List paramchains(nchains);
+    Rcpp::NumericMatrix llchains(outputparam ? nsims : 0, nchains);
+    Rcpp::NumericVector waic1(nchains);
+    Rcpp::NumericVector waic2(nchains);
+    Rcpp::List finals(nchains);
+
+    for (unsigned int c=0; c<nchains; c++)
+    {
+        Rcpp::List paramchain(res[c].params.size());
+        for (unsigned int i=0; i<res[c].params.size(); i++)
+        {
+            paramchain(i) = model2R(models[c], res[c].params[i]);
+            llchains(i,c) = res[c].loglik[i];
+        }
+        paramchains(c) = paramchain;
+        waic1(c) = res[c].waic.waic1();
+        waic2(c) = res[c].waic.waic2();
+        if (outputfinal)
+            finals(c) = model2R(models[c], res[c].final);
+    }
+
+    Rcpp::List MCMCParameters = Rcpp::List::create(
+        _["nsims"] = nsims,
+        _["nburn"] = nburn,
+        _["outputparam"] = outputparam,
+        _["outputfinal"] = outputfinal,
+        _["nchains"] = nchains,
+        _["seed"] = (double) master
+    );
+
+    Rcpp::List ret = Rcpp::List::create(
+        _["Parameters"] = tracefiles.empty() ? (SEXP) paramchains : R_NilValue,
+        _["LogLikelihood"] = llchains,
+        _["MCMCParameters"] = MCMCParameters,
+        _["ModelParameters"] = modelParameters,
+        _["waic1"] = waic1,
+        _["waic2"] = waic2
+    );
+
+    std::vector<const PointwiseWAIC *> waics;
+    for (unsigned int c=0; c<nchains; c++)
+        waics.push_back(&res[c].waic);
+    waicOutput(ret, waics, res[0].testtime, res[0].testpatient, loothin);
+
+    if (outputfinal)
+        ret["FinalModel"] = finals;
+    if (!tracefiles.empty())
+        ret["TraceFile"] = tracefiles;
+    if (profile)
+    {
+        std::vector< std::vector<ProfileRow> > profiles;
+        for (unsigned int c=0; c<nchains; c++)
+            profiles.push_back(res[c].profile);
+        ret["Profile"] = profileFrame(profiles);
+    }
+
+    for (unsigned int i=0; i<nchains; i++)
+        delete models[i];
+
+    return ret;
+}
+
+// Single chain version of runMCMC. The chain uses stream 0 of a
+// XoshiroRandom seeded with master, as the first chain of runMCMCChains()
+// does, so no draw goes through R. If cc is given the chain is checkpointed and, if cc->from is set,
+// resumed. If profile is set the sampler is profiled, burn-in included.
+SEXP runMCMCChain(
+    Rcpp::DataFrame data,
+    Rcpp::List modelParameters,
+    unsigned int nsims,
+    unsigned int nburn,
+    bool outputparam,
+    bool outputfinal,
+    bool verbose,
+    unsigned int nthreads,
+    uint64_t master,
+    const std::vector<std::string> &tracefiles,
+    const ChainCheckpoint *cc,
+    bool profile,
+    unsigned int loothin
 ) {
     if(verbose)
         Rcpp::message(Rcpp::wrap(string("Initializing Variables")));
@@ -144,7 +437,7 @@ SEXP runMCMC(
 
     if(verbose) Rcpp::Rcout << "Creating RNG...";
 
-    RRandom *random = new RRandom();
+    std::unique_ptr<XoshiroRandom> random(new XoshiroRandom(master, 0));
 
     if(verbose) Rcpp::Rcout << "Done" << std::endl;
 
@@ -153,38 +446,29 @@ SEXP runMCMC(
     // Validate data is sorted by patient, then time
     std::vector<int> patients = as<std::vector<int>>(data[3]);
     std::vector<double> times = as<std::vector<double>>(data[2]);
-    
-    for (size_t i = 1; i < patients.size(); i++) {
-        if (patients[i] < patients[i-1]) {
-            Rcpp::stop("Data must be sorted by patient ID, then time. "
-                      "Row %d has patient %d, but previous row had patient %d. "
-                      "Please sort your data: data[order(data$patient, data$time), ]",
-                      i+1, patients[i], patients[i-1]);
-        }
-        if (patients[i] == patients[i-1] && times[i] < times[i-1]) {
-            Rcpp::stop("Data must be sorted by patient ID, then time. "
-                      "For patient %d, row %d has time %.4f which is before row %d time %.4f. "
-                      "Please sort your data: data[order(data$patient, data$time), ]",
-                      patients[i], i+1, times[i], i, times[i-1]);
-        }
-    }
+    checkSorted(patients, times);
 
-    System *sys = new System(
+    std::unique_ptr<System> sys(new System(
         as<std::vector<int>>(data[0]),//facility
         as<std::vector<int>>(data[1]),//unit
         times,//"time"
         patients,//"patient"
         as<std::vector<int>>(data[4])//"event type"
-    );
+    ));
     if (verbose) Rcpp::Rcout << "Done" << std::endl;
 
 
     //Model
     if (verbose) Rcpp::Rcout << "Creating model...";
 
-    lognormal::LogNormalModel *model = newModel(modelParameters, verbose);
+    std::unique_ptr<lognormal::LogNormalModel> model(newModel(modelParameters, verbose, sys.get()));
     if (verbose) Rcpp::Rcout << "Done" << std::endl;
 
+    // A single chain uses the threads to sample patient episodes and to
+    // count the units' statistics. Zero keeps the sequential sweeps.
+    model->setEpisodeThreads(nthreads);
+    model->setUnitThreads(nthreads);
+
     // Set time origin of model.
     LogNormalICP *icp = (LogNormalICP *) model->getInColParams();
     icp->setTimeOrigin((sys->endTime()-sys->startTime())/2.0);
@@ -195,39 +479,44 @@ SEXP runMCMC(
 
     if (verbose) Rcpp::Rcout << "Building history structure...";
 
-    SystemHistory *hist = new SystemHistory(sys, model, false);
+    std::unique_ptr<SystemHistory> hist(new SystemHistory(sys.get(), model.get(), false));
     if (verbose) Rcpp::Rcout << "Done" << std::endl;
 
     // Find tests for posterior prediction and, hence, WAIC estimates.
 
     if (verbose) Rcpp::message(Rcpp::wrap(string("Finding tests for WAIC.\n")));
 
-    util::List* tests = hist->getTestLinks();
-    TestParams** testtype = new TestParams*[tests->size()];
-    HistoryLink** histlink = new HistoryLink*[tests->size()];
-
-    int wntests = 0;
-    double wprob = 0;
-    double wlogprob = 0;
-    double wlogsqprob = 0;
-    for (tests->init(); tests->hasNext(); wntests++)
+    WAICTests tests(hist.get(), model.get());
+    PointwiseWAIC waic(tests.size(), loothin);
+    std::vector<double> testtime;
+    std::vector<int> testpatient;
+    for (unsigned int j=0; j<tests.size(); j++)
     {
-        histlink[wntests] = (HistoryLink *) tests->next();
-
-        if (histlink[wntests]->getEvent()->isClinicalTest())
-            testtype[wntests] = model->getClinicalTestParams();
-        else
-            testtype[wntests] = model->getSurveillanceTestParams();
+        testtime.push_back(tests.time(j));
+        testpatient.push_back(tests.patient(j));
     }
 
     // Make and runsampler.
 
-    Rcpp::List paramchain(nsims);
+    // Parameter values go to the trace file, if there is one, rather than
+    // into a list.
+    std::unique_ptr<TraceWriter> trace;
+    if (!tracefiles.empty())
+        trace.reset(new TraceWriter(tracefiles[0], traceNames(model.get()), outputparam ? nsims : 0));
+    std::vector<double> row;
+
+    Rcpp::List paramchain(!trace ? nsims : 0);
     Rcpp::NumericVector llchain(nsims);
     if (verbose)
         Rcpp::message(Rcpp::wrap(string("Building sampler.\n")));
 
-    Sampler *mc = new Sampler(hist,model,random);
+    std::unique_ptr<Sampler> mc(new Sampler(hist.get(),model.get(),random.get()));
+    resumeChain(cc, hist.get(), mc.get(), model.get(), random.get());
+    resumeWAIC(cc, waic);
+
+    uint64_t done = chainStart(cc);
+    unsigned int burn = chainBurninLeft(cc, nburn);
+    nburn = chainBurnin(cc, nburn);
 
     if (verbose)
     {
@@ -254,7 +543,7 @@ SEXP runMCMC(
             ss << "\t";
         }
         
-        double initialLogLike = model->logLikelihood(hist);
+        double initialLogLike = model->logLikelihood(hist.get());
         if (std::isinf(initialLogLike) || std::isnan(initialLogLike)) {
             Rcpp::Rcerr << "\nWARNING: Initial log likelihood is " << initialLogLike << "\n";
             Rcpp::Rcerr << "This suggests a problem with model initialization or data.\n";
@@ -263,16 +552,24 @@ SEXP runMCMC(
         Rcpp::Rcout << "=== END INITIAL PARAMETERS ===\n" << std::endl;
     }
 
+    Profile prof;
+    Profile::Use use(profile ? &prof : 0);
+    if (profile)
+        icp->clearAcceptance();
+
     if (verbose)
         Rcpp::message(Rcpp::wrap(string("burning in MCMC.\n")));
-    for (unsigned int i=0; i<nburn; i++)
+    model->setAdapting(true);
+    for (unsigned int i=0; i<burn; i++)
     {
         if(verbose) Rcout << i << ":sample episodes...";
         mc->sampleEpisodes();
         if(verbose) Rcout << "Sample Model...";
         mc->sampleModel();
+        checkpointChain(cc, ++done, nburn, false, hist.get(), model.get(), random.get(), trace.get(), &waic);
         if(verbose) Rcout << "done." << std::endl;
     }
+    model->setAdapting(false);
 
     if (verbose)
         Rcpp::message(Rcpp::wrap(string("Running MCMC.\n")));
@@ -289,31 +586,35 @@ SEXP runMCMC(
         {
             if (verbose)
                 Rcout << "Outputting parameters...";
-            paramchain(i) = model2R(model);
             if (verbose) Rcout << "likelhood...";
-            llchain(i) = model->logLikelihood(hist);
+            llchain(i) = mc->logLikelihood();
+            if (trace)
+            {
+                traceRow(model.get(), llchain(i), row);
+                trace->write(&row[0]);
+            }
+            else
+            {
+                paramchain(i) = model2R(model.get());
+            }
         }
 
-        for (int j=0; j<wntests; j++)
-        {
-            HistoryLink *hh = histlink[j];
-            double p = testtype[j]->eventProb(hh->getPState()->infectionStatus(),hh->getPState()->onAbx(),hh->getEvent()->getType());
-            wprob += p;
-            wlogprob += log(p);
-            wlogsqprob += log(p)*log(p);
-        }
+        tests.sample(waic, model->getUnitThreads());
 
+        checkpointChain(cc, ++done, nburn, false, hist.get(), model.get(), random.get(), trace.get(), &waic);
         if(verbose) Rcout << "done." << std::endl;
     }
 
     if (verbose)
         Rcpp::message(Rcpp::wrap(string("MCMC done.\n")));
 
-    wprob /= wntests * nsims;
-    wlogprob /= wntests * nsims;
-    wlogsqprob /= wntests * nsims;
-    double waic1 = 2*log(wprob) - 4*wlogprob;
-    double waic2 = -2 * log(wprob) - 2 * wlogprob*wlogprob + 2 * wlogsqprob;
+    if (trace)
+        trace->close();
+    checkpointChain(cc, done, nburn, true, hist.get(), model.get(), random.get(), trace.get(), &waic);
+    trace.reset();
+
+    double waic1 = waic.waic1();
+    double waic2 = waic.waic2();
     if (verbose) Rcout << "WAIC 1 2 = \t" << waic1 << "\t" << waic2 << "\n";
 
 /*
@@ -324,11 +625,12 @@ SEXP runMCMC(
         _["nsims"] = nsims,
         _["nburn"] = nburn,
         _["outputparam"] = outputparam,
-        _["outputfinal"] = outputfinal
+        _["outputfinal"] = outputfinal,
+        _["seed"] = (double) master
     );
 
     Rcpp::List ret = Rcpp::List::create(
-        _["Parameters"] = paramchain,
+        _["Parameters"] = tracefiles.empty() ? (SEXP) paramchain : R_NilValue,
         _["LogLikelihood"] = llchain,
         _["MCMCParameters"] = MCMCParameters,
         _["ModelParameters"] = modelParameters,
@@ -338,20 +640,28 @@ SEXP runMCMC(
         _["waic2"] = waic2
     );
 
+    waicOutput(ret, std::vector<const PointwiseWAIC *>(1, &waic), testtime, testpatient, loothin);
+
     if(outputfinal)
     {
         if (verbose) Rcout << "Writing complete form of final state." << std::endl;
 
-        ret["FinalModel"] = model2R(model);
+        ret["FinalModel"] = model2R(model.get());
     }
-    delete [] histlink;
-    delete [] testtype;
-    delete tests;
-    delete mc;
-    delete hist;
-    delete sys;
-    delete model;
-    delete random;
+    if (!tracefiles.empty())
+        ret["TraceFile"] = tracefiles;
+    if (profile)
+    {
+        std::vector< std::vector<ProfileRow> > profiles(1);
+        profileRows(prof, model.get(), profiles[0]);
+        ret["Profile"] = profileFrame(profiles);
+    }
+
+    mc.reset();
+    hist.reset();
+    sys.reset();
+    model.reset();
+    random.reset();
     // Don't delete static members - they are shared across all invocations
     // Instead, clear them for the next run
     if (AbxCoding::sysabx != 0)
@@ -363,6 +673,492 @@ SEXP runMCMC(
 
 }
 
+//' Run Bayesian Transmission MCMC
+//'
+//' @param data Data frame with columns, in order: facility, unit, time, patient, and event type.
+//' @param modelParameters List of model parameters, see <LogNormalModelParams>.
+//' @param nsims Number of MCMC samples to collect after burn-in.
+//' @param nburn Number of burn-in iterations.
+//' @param outputparam Whether to output parameter values at each iteration.
+//' @param outputfinal Whether to output the final model state.
+//' @param verbose Print progress messages.
+//' @param nchains Number of independent chains. Each chain has its own
+//'   C++ random number stream, rather than using R's random number
+//'   generator, and with more than one chain each is run on its own thread.
+//' @param nthreads Number of threads. Multiple chains are spread over the
+//'   threads; a single chain uses them to sample patient episodes in
+//'   parallel, in batches of patients that share no unit, and to count the
+//'   statistics of the units and to find the predictive probabilities of
+//'   the tests in parallel. The results do not depend on the number of
+//'   threads. Zero samples the episodes of a single chain one patient at a
+//'   time and counts its units' statistics one after another, as the
+//'   sequential sampler does, which gives different draws from
+//'   `nthreads = 1`.
+//' @param seed Master seed for the chain random number streams, a whole
+//'   number from 0 to 2^53 - 1. If `NULL` it is drawn from R's random
+//'   number generator, so `set.seed()` still gives reproducible results.
+//' @param outputfile Path of a binary trace file, or one path per chain
+//'   when `nchains > 1`. If given, the parameter values and log likelihood
+//'   at each iteration are written to the file as the chain runs instead of
+//'   being kept in memory, and `Parameters` is `NULL` in the result. Read
+//'   the trace back with [readMCMCTrace()].
+//' @param checkpoint Path of a checkpoint file, or one path per chain when
+//'   `nchains > 1`. If given, the state of the chain is written to the
+//'   file every `checkpointevery` iterations and at the end, and the chain
+//'   can be carried on later with [resumeMCMC()].
+//' @param checkpointevery Number of iterations, burn-in included, between
+//'   checkpoints. Zero only writes one at the end.
+//' @param profile If `TRUE`, time the steps of the sampler and count the
+//'   matrix exponentials and proposals made, burn-in included, and return
+//'   them as `Profile`. Profiling adds a little overhead so is off by
+//'   default.
+//' @param loothin If not zero, keep the log predictive probability of each
+//'   test at every `loothin`-th iteration after burn-in and return them as
+//'   `PointwiseLogLik`, for PSIS-LOO with, say, `loo::loo()`. The values
+//'   are kept as single precision floats.
+//'
+//' @return A list with the following elements:
+//'   * `Parameters` the MCMC chain of model parameters (if outputparam=TRUE)
+//'   * `LogLikelihood` the log likelihood of the model at each iteration (if outputparam=TRUE)
+//'   * `MCMCParameters` the MCMC parameters used
+//'   * `ModelParameters` the model parameters used
+//'   * `ModelName` the name of the model
+//'   * `nstates` the number of states in the model
+//'   * `waic1` the WAIC1 estimate
+//'   * `waic2` the WAIC2 estimate
+//'   * `waic` the WAIC, -2 times the sum over the tests of the log
+//'     pointwise predictive density less its variance over the draws.
+//'   * `Pointwise` a data frame with one row per test, with columns
+//'     `patient`, `time`, `lppd` and `p_waic`, the terms of `waic`.
+//'   * `PointwiseLogLik` (if loothin > 0) a matrix of the kept log
+//'     predictive probabilities, one row per kept iteration and one column
+//'     per test in the order of `Pointwise`.
+//'   * and optionally (if outputfinal=TRUE) `FinalModel` the final model state.
+//'   * `TraceFile` the trace file paths (if outputfile is given).
+//'   * `Profile` (if profile=TRUE) a data frame with columns `chain`,
+//'     `name`, `calls`, `seconds`, `accepted` and `rate`: one row per
+//'     chain for each timed step, for the `expQt` and `expQt.memo` counts
+//'     of matrix exponentials computed and found in the memo, for the
+//'     patient `episodes` proposed and accepted, and for each in unit
+//'     parameter updated by Metropolis-Hastings.
+//'
+//'   When `nchains > 1` results are stacked per chain: `Parameters` and
+//'   `FinalModel` are lists with one element per chain, `LogLikelihood` is
+//'   an `nsims` by `nchains` matrix, and `waic1` and `waic2` have one value
+//'   per chain. `waic` and `Pointwise` pool the draws of all the chains,
+//'   and `PointwiseLogLik` has the rows of each chain in turn.
+//' @examples
+//' \dontrun{
+//'   # Minimal example: create parameters and run a very short MCMC
+//'   params <- LinearAbxModel(nstates = 2)
+//'   data(simulated.data_sorted, package = "bayestransmission")
+//'   results <- runMCMC(
+//'     data = simulated.data_sorted,
+//'     modelParameters = params,
+//'     nsims = 1,
+//'     nburn = 0,
+//'     outputparam = TRUE,
+//'     outputfinal = FALSE,
+//'     verbose = FALSE
+//'   )
+//'   str(results)
+//' }
+//' @export
+// [[Rcpp::export]]
+SEXP runMCMC(
+    Rcpp::DataFrame data,
+    Rcpp::List modelParameters,
+    unsigned int nsims,
+    unsigned int nburn = 100,
+    bool outputparam = true,
+    bool outputfinal = false,
+    bool verbose = false,
+    unsigned int nchains = 1,
+    unsigned int nthreads = 1,
+    Rcpp::Nullable<double> seed = R_NilValue,
+    Rcpp::Nullable<Rcpp::CharacterVector> outputfile = R_NilValue,
+    Rcpp::Nullable<Rcpp::CharacterVector> checkpoint = R_NilValue,
+    unsigned int checkpointevery = 0,
+    bool profile = false,
+    unsigned int loothin = 0
+) {
+    if (nchains < 1)
+        Rcpp::stop("nchains must be at least 1");
+
+    std::vector<std::string> tracefiles = traceFiles(outputfile, nchains);
+    uint64_t master = masterSeed(seed);
+    std::vector<ChainCheckpoint> checkpoints = chainCheckpoints(checkpoint, checkpointevery, nchains, modelParameters, master);
+
+    if (nchains > 1)
+        return runMCMCChains(data, modelParameters, nsims, nburn, outputparam, outputfinal, verbose, nchains, nthreads, master, tracefiles, checkpoints, profile, loothin);
+
+    return runMCMCChain(data, modelParameters, nsims, nburn, outputparam, outputfinal, verbose, nthreads, master, tracefiles, checkpoints.empty() ? 0 : &checkpoints[0], profile, loothin);
+}
+
+//' Resume Bayesian Transmission MCMC from checkpoints
+//'
+//' Carries on chains from checkpoints written by [runMCMC()] or by an
+//' earlier call to `resumeMCMC()`. The sampled episode histories, the
+//' model parameters and the random number generator state are restored
+//' from the checkpoints, so the chains continue where they left off and
+//' any burn-in that was already run is not run again. The model settings
+//' are kept in the checkpoints, but the data must be given again.
+//'
+//' The checkpoints hold the state of each chain's random number stream, so
+//' resuming gives the same draws as an uninterrupted run. The WAIC
+//' accumulators are kept in the checkpoints too, so the WAIC estimates
+//' cover all the iterations after burn-in, while `PointwiseLogLik` only
+//' has those run by this call.
+//'
+//' @param data Data frame with columns, in order: facility, unit, time, patient, and event type.
+//'   Must be the same data the chains were started with.
+//' @param checkpoint Paths of the checkpoint files, one per chain. New
+//'   checkpoints are written back to the same files.
+//' @param nsims Number of further MCMC samples to collect.
+//' @inheritParams runMCMC
+//'
+//' @return A list as returned by [runMCMC()], for the iterations run by
+//'   this call apart from the WAIC estimates. The `seed` in
+//'   `MCMCParameters` is the one the chains were started with.
+//' @examples
+//' \dontrun{
+//'   params <- LinearAbxModel(nstates = 2)
+//'   data(simulated.data_sorted, package = "bayestransmission")
+//'   path <- tempfile(fileext = ".ckpt")
+//'   first <- runMCMC(simulated.data_sorted, params, nsims = 10, nburn = 10,
+//'                    checkpoint = path)
+//'   more <- resumeMCMC(simulated.data_sorted, path, nsims = 10)
+//' }
+//' @export
+// [[Rcpp::export]]
+SEXP resumeMCMC(
+    Rcpp::DataFrame data,
+    Rcpp::CharacterVector checkpoint,
+    unsigned int nsims,
+    bool outputparam = true,
+    bool outputfinal = false,
+    bool verbose = false,
+    unsigned int nthreads = 1,
+    Rcpp::Nullable<Rcpp::CharacterVector> outputfile = R_NilValue,
+    unsigned int checkpointevery = 0,
+    unsigned int loothin = 0
+) {
+    unsigned int nchains = checkpoint.size();
+    if (nchains < 1)
+        Rcpp::stop("checkpoint must give at least one path");
+
+    std::vector<std::string> paths = Rcpp::as< std::vector<std::string> >(checkpoint);
+    std::vector<Checkpoint> from(nchains);
+    for (unsigned int c=0; c<nchains; c++)
+        readCheckpoint(paths[c], from[c]);
+
+    if (from[0].setup.empty())
+        Rcpp::stop("Checkpoint %s has no model parameters", paths[0]);
+    Rcpp::Function unserialize("unserialize");
+    Rcpp::List modelParameters = unserialize(Rcpp::RawVector(from[0].setup.begin(), from[0].setup.end()));
+
+    // The seed the chains were started with is passed on to be reported
+    // and kept in the new checkpoints. It seeds nothing, as each chain's
+    // generator state comes from its checkpoint.
+    uint64_t master = from[0].seed;
+
+    std::vector<std::string> tracefiles = traceFiles(outputfile, nchains);
+    std::vector<ChainCheckpoint> checkpoints = chainCheckpoints(checkpoint, checkpointevery, nchains, modelParameters, master);
+    for (unsigned int c=0; c<nchains; c++)
+        checkpoints[c].from = &from[c];
+
+    unsigned int nburn = from[0].nburn;
+
+    if (nchains > 1)
+        return runMCMCChains(data, modelParameters, nsims, nburn, outputparam, outputfinal, verbose, nchains, nthreads, master, tracefiles, checkpoints, false, loothin);
+
+    return runMCMCChain(data, modelParameters, nsims, nburn, outputparam, outputfinal, verbose, nthreads, master, tracefiles, &checkpoints[0], false, loothin);
+}
+
+//' Read an MCMC trace file
+//'
+//' Reads a trace file written by [runMCMC()] with `outputfile` set. The
+//' columns are read straight into the storage of the returned matrix, so
+//' no other copy of the trace is made. A file from a run that was stopped
+//' part way through gives the rows written so far, up to the last block.
+//'
+//' @param path Path of the trace file.
+//'
+//' @return A numeric matrix with one row per iteration and one column per
+//'   model parameter, named as in the `Parameters` output of [runMCMC()],
+//'   followed by a `LogLikelihood` column.
+//' @examples
+//' \dontrun{
+//'   params <- LinearAbxModel(nstates = 2)
+//'   data(simulated.data_sorted, package = "bayestransmission")
+//'   path <- tempfile(fileext = ".trace")
+//'   results <- runMCMC(simulated.data_sorted, params, nsims = 10,
+//'                      nburn = 0, outputfile = path)
+//'   trace <- readMCMCTrace(path)
+//'   plot(trace[, "LogLikelihood"], type = "l")
+//' }
+//' @export
+// [[Rcpp::export]]
+Rcpp::NumericMatrix readMCMCTrace(std::string path)
+{
+    TraceReader reader(path);
+
+    if (reader.rows() > (uint64_t) INT_MAX)
+        Rcpp::stop("Trace file %s has too many rows for an R matrix", path);
+
+    int n = reader.rows();
+    int m = reader.columns();
+    Rcpp::NumericMatrix x(n, m);
+    for (int j=0; j<m; j++)
+        reader.read(j, x.begin() + (size_t) j * n);
+
+    Rcpp::colnames(x) = Rcpp::wrap(reader.columnNames());
+    return x;
+}
+
+// Posterior draws as values in the order of modelValues(), from either the
+// Parameters output of runMCMC(), a list with an element for each
+// iteration, or a matrix read by readMCMCTrace().
+std::vector< std::vector< std::vector<double> > > drawValues(SEXP draws, const lognormal::LogNormalModel *model)
+{
+    const char *names[] = {"Insitu", "SurveillanceTest", "ClinicalTest", "OutCol", "InCol", "Abx"};
+    std::vector<size_t> sizes;
+    size_t total = 0;
+    for (int i=0; i<nModelComponents; i++)
+    {
+        sizes.push_back(modelComponent(model,i)->getValues().size());
+        total += sizes.back();
+    }
+
+    std::vector< std::vector< std::vector<double> > > values;
+
+    if (Rf_isMatrix(draws))
+    {
+        Rcpp::NumericMatrix x(draws);
+        if ((size_t) x.ncol() < total)
+            Rcpp::stop("draws has %d columns but the model has %d values", x.ncol(), (int) total);
+
+        // Any columns after the model values, such as LogLikelihood, are
+        // not used.
+        for (int r=0; r<x.nrow(); r++)
+        {
+            std::vector< std::vector<double> > v(nModelComponents);
+            size_t k = 0;
+            for (int i=0; i<nModelComponents; i++)
+                for (size_t j=0; j<sizes[i]; j++)
+                    v[i].push_back(x(r,k++));
+            values.push_back(v);
+        }
+        return values;
+    }
+
+    if (TYPEOF(draws) != VECSXP)
+        Rcpp::stop("draws must be a list of parameter values or a matrix");
+
+    Rcpp::List x(draws);
+    for (int r=0; r<x.size(); r++)
+    {
+        Rcpp::List d = x[r];
+        std::vector< std::vector<double> > v(nModelComponents);
+        for (int i=0; i<nModelComponents; i++)
+        {
+            if (!d.containsElementNamed(names[i]))
+                Rcpp::stop("Draw %d has no %s values", r+1, names[i]);
+            v[i] = Rcpp::as< std::vector<double> >(d[names[i]]);
+            if (v[i].size() != sizes[i])
+                Rcpp::stop("Draw %d has %d %s values but the model has %d", r+1, (int) v[i].size(), names[i], (int) sizes[i]);
+        }
+        values.push_back(v);
+    }
+    return values;
+}
+
+// The counts of field for each simulation as an array by unit, bin and
+// simulation.
+Rcpp::IntegerVector predictiveArray(const PredictiveResult &res, std::vector<int> PredictiveCounts::*field)
+{
+    int nu = res.units.size();
+    int nb = res.nbins;
+    int ns = res.sims.size();
+    Rcpp::IntegerVector x(nu * nb * ns);
+    for (int k=0; k<ns; k++)
+    {
+        const std::vector<int> &c = res.sims[k].*field;
+        for (int u=0; u<nu; u++)
+            for (int b=0; b<nb; b++)
+                x[u + (size_t) nu * (b + (size_t) nb * k)] = c[(size_t) u * nb + b];
+    }
+    x.attr("dim") = Rcpp::IntegerVector::create(nu, nb, ns);
+    return x;
+}
+
+// The observed counts of field as a matrix by unit and bin.
+Rcpp::IntegerMatrix observedMatrix(const PredictiveResult &res, std::vector<int> PredictiveCounts::*field)
+{
+    int nu = res.units.size();
+    int nb = res.nbins;
+    Rcpp::IntegerMatrix x(nu, nb);
+    const std::vector<int> &c = res.observed.*field;
+    for (int u=0; u<nu; u++)
+        for (int b=0; b<nb; b++)
+            x(u,b) = c[(size_t) u * nb + b];
+    return x;
+}
+
+//' Posterior predictive simulation
+//'
+//' Simulates the colonization events and test results again under
+//' posterior draws of the model parameters, keeping the admissions,
+//' discharges and test times of the data, and returns summary counts of
+//' each simulation per unit and time bin for posterior predictive checks.
+//' The simulations are spread over threads, each with its own copy of the
+//' data, and only the counts asked for are kept.
+//'
+//' @param data Data frame with columns, in order: facility, unit, time, patient, and event type.
+//' @param modelParameters List of model parameters, see <LogNormalModelParams>,
+//'   as given to [runMCMC()]. The model is made forward enabled whatever
+//'   its `forward` setting.
+//' @param draws Posterior draws of the parameter values: either the
+//'   `Parameters` output of a single chain of [runMCMC()], or a matrix as
+//'   returned by [readMCMCTrace()], one row per draw.
+//' @param nreps Number of simulations for each draw.
+//' @param stats Counts to keep: `"positivity"` for the number of tests and
+//'   of positive tests, and `"acquisitions"` for the number of
+//'   acquisitions in the units.
+//' @param binwidth Width of the time bins, from the first event time. The
+//'   default gives weekly counts when times are in days.
+//' @param nthreads Number of threads, each with its own copy of the model
+//'   and data. Zero is taken as one. The results do not depend on the
+//'   number of threads.
+//' @param seed Seed for the random number streams, one per simulation, a
+//'   whole number from 0 to 2^53 - 1. If `NULL` it is drawn from R's random
+//'   number generator.
+//'
+//' @return A list with the following elements:
+//'   * `Units` a data frame with the `facility` and `unit` of each unit.
+//'   * `Bins` the start time of each time bin.
+//'   * `Draw` the row of `draws` each simulation used.
+//'   * `Observed` (if positivity is kept) a list with matrices `Tests` and
+//'     `Positives` of the counts in the data, by unit and bin.
+//'   * `Tests` and `Positives` (if positivity is kept) and `Acquisitions`
+//'     (if acquisitions are kept) arrays of counts by unit, bin and
+//'     simulation.
+//' @examples
+//' \dontrun{
+//'   params <- LinearAbxModel(nstates = 2)
+//'   data(simulated.data_sorted, package = "bayestransmission")
+//'   results <- runMCMC(simulated.data_sorted, params, nsims = 20, nburn = 10)
+//'   ppc <- posteriorPredictive(simulated.data_sorted, params,
+//'                              results$Parameters, nreps = 5)
+//'   rate <- apply(ppc$Positives, 3, sum) / apply(ppc$Tests, 3, sum)
+//'   hist(rate)
+//'   abline(v = sum(ppc$Observed$Positives) / sum(ppc$Observed$Tests))
+//' }
+//' @export
+// [[Rcpp::export]]
+SEXP posteriorPredictive(
+    Rcpp::DataFrame data,
+    Rcpp::List modelParameters,
+    SEXP draws,
+    unsigned int nreps = 1,
+    Rcpp::CharacterVector stats = Rcpp::CharacterVector::create("positivity", "acquisitions"),
+    double binwidth = 7,
+    unsigned int nthreads = 1,
+    Rcpp::Nullable<double> seed = R_NilValue
+) {
+    PredictiveOptions opt;
+    opt.positivity = false;
+    opt.acquisitions = false;
+    for (int i=0; i<stats.size(); i++)
+    {
+        std::string x = Rcpp::as<std::string>(stats[i]);
+        if (x == "positivity")
+            opt.positivity = true;
+        else if (x == "acquisitions")
+            opt.acquisitions = true;
+        else
+            Rcpp::stop("Unknown statistic: %s", x);
+    }
+    opt.binwidth = binwidth;
+    opt.nreps = nreps;
+
+    ChainData cd;
+    cd.facilities = as<std::vector<int>>(data[0]);
+    cd.units = as<std::vector<int>>(data[1]);
+    cd.times = as<std::vector<double>>(data[2]);
+    cd.patients = as<std::vector<int>>(data[3]);
+    cd.types = as<std::vector<int>>(data[4]);
+    checkSorted(cd.patients, cd.times);
+
+    uint64_t master = masterSeed(seed);
+
+    if (nthreads < 1)
+        nthreads = 1;
+
+    // One model for each thread, made here as reading modelParameters uses
+    // the R API. They are made inside the try so that they are freed if
+    // one of them fails.
+    System *sys = 0;
+    std::vector<lognormal::LogNormalModel *> models;
+    PredictiveResult res;
+    std::string error;
+    try
+    {
+        if (Rcpp::as<std::string>(modelParameters["modname"]) == "MultiUnitAbxModel")
+            sys = new System(cd.facilities, cd.units, cd.times, cd.patients, cd.types);
+        for (unsigned int i=0; i<nthreads; i++)
+            models.push_back(newModel(modelParameters, false, sys));
+        if (sys != 0)
+            delete sys;
+        sys = 0;
+
+        std::vector< std::vector< std::vector<double> > > values = drawValues(draws, models[0]);
+        simulatePredictive(cd, models, values, opt, master, res);
+    }
+    catch (std::exception &e)
+    {
+        error = e.what();
+    }
+
+    if (sys != 0)
+        delete sys;
+    for (unsigned int i=0; i<models.size(); i++)
+        delete models[i];
+    if (error != "")
+        Rcpp::stop(error);
+
+    Rcpp::NumericVector bins(res.nbins);
+    for (unsigned int b=0; b<res.nbins; b++)
+        bins[b] = res.start + b * binwidth;
+
+    Rcpp::IntegerVector draw(res.sims.size());
+    for (unsigned int k=0; k<res.sims.size(); k++)
+        draw[k] = k / nreps + 1;
+
+    Rcpp::List ret = Rcpp::List::create(
+        _["Units"] = Rcpp::DataFrame::create(
+            _["facility"] = res.facilities,
+            _["unit"] = res.units
+        ),
+        _["Bins"] = bins,
+        _["Draw"] = draw
+    );
+
+    if (opt.positivity)
+    {
+        ret["Observed"] = Rcpp::List::create(
+            _["Tests"] = observedMatrix(res, &PredictiveCounts::tests),
+            _["Positives"] = observedMatrix(res, &PredictiveCounts::positives)
+        );
+        ret["Tests"] = predictiveArray(res, &PredictiveCounts::tests);
+        ret["Positives"] = predictiveArray(res, &PredictiveCounts::positives);
+    }
+    if (opt.acquisitions)
+        ret["Acquisitions"] = predictiveArray(res, &PredictiveCounts::acquisitions);
+
+    return ret;
+}
+
 //' Create a new model object
 //'
 //' Creates and initializes a model object based on the provided parameters.
@@ -436,7 +1232,7 @@ Rcpp::List testHistoryLinkLogLikelihoods(Rcpp::List modelParameters) {
     );
     
     if (verbose) Rcpp::Rcout << "Building model..." << std::endl;
-    lognormal::LogNormalModel *model = newModel(modelParameters, verbose);
+    lognormal::LogNormalModel *model = newModel(modelParameters, verbose, sys);
     
     // Set time origin of model
     LogNormalICP *icp = (LogNormalICP *) model->getInColParams();
@@ -0,0 +1,100 @@
+// util/Arena.h
+#ifndef ALUN_UTIL_ARENA_H
+#define ALUN_UTIL_ARENA_H
+
+#include <stddef.h>
+#include <vector>
+#include "Object.h"
+
+namespace util{
+/*
+	Bump allocator for short lived working storage.
+	Memory is handed out in order from a block and is only given back, all
+	at once, by reset(). If a block runs out another is added, and the next
+	reset() replaces them all by one block big enough for the lot, so after
+	a few rounds of the same work no more heap allocation is done.
+	Only use it for types that need no destructor.
+*/
+class Arena : public Object
+{
+private:
+	static const size_t align = alignof(max_align_t);
+	static const size_t minblock = 1UL << 16;
+
+	std::vector<char *> blocks;
+	size_t cap;
+	size_t used;
+	size_t total;
+
+	inline void grow(size_t n)
+	{
+		size_t c = cap * 2;
+		if (c < minblock)
+			c = minblock;
+		if (c < n)
+			c = n;
+		blocks.push_back(new char[c]);
+		cap = c;
+		used = 0;
+	}
+
+public:
+	Arena()
+	{
+		cap = 0;
+		used = 0;
+		total = 0;
+	}
+
+	~Arena()
+	{
+		for (size_t i=0; i<blocks.size(); i++)
+			delete [] blocks[i];
+	}
+
+	// Frees everything handed out since the last reset.
+	inline void reset()
+	{
+		if (blocks.size() > 1)
+		{
+			for (size_t i=0; i<blocks.size(); i++)
+				delete [] blocks[i];
+			blocks.clear();
+			cap = 0;
+			grow(total);
+		}
+		used = 0;
+		total = 0;
+	}
+
+	// Uninitialized storage for n objects of type T.
+	template <typename T> inline T *alloc(int n)
+	{
+		size_t k = ((n * sizeof(T)) + align - 1) & ~(align - 1);
+		if (blocks.empty() || used + k > cap)
+			grow(k);
+		T *x = (T *) (blocks.back() + used);
+		used += k;
+		total += k;
+		return x;
+	}
+
+	// Zeroed n by m matrix, as Allocator::cleanAlloc(n,m).
+	inline double **cleanAlloc(int n, int m)
+	{
+		double **x = alloc<double *>(n);
+		double *y = alloc<double>(n*m);
+		for (int i=0; i<n*m; i++)
+			y[i] = 0;
+		for (int i=0; i<n; i++)
+			x[i] = y + i*m;
+		return x;
+	}
+
+	std::string className() const override
+	{
+		return "Arena";
+	}
+};
+} // namespace util
+#endif // ALUN_UTIL_ARENA_H
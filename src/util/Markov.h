@@ -9,6 +9,7 @@ using std::ostream;
 
 #include "Object.h"
 #include "Random.h"
+#include "Arena.h"
 
 
 namespace util{
@@ -51,22 +52,10 @@ struct checkpoint
 		RR = 0;
 	}
 
-	void alloc(int ns)
+	void alloc(int ns, Arena *a)
 	{
-		R = new double[ns];
-		RR = new double*[ns];
-		for (int i=0; i<ns; i++)
-			RR[i] = new double[ns];
-	}
-
-	void dealloc(int ns)
-	{
-		delete [] R;
-		R = 0;
-		for (int i=0; i<ns; i++)
-			delete [] RR[i];
-		delete [] RR;
-		RR = 0;
+		R = a->alloc<double>(ns);
+		RR = a->cleanAlloc(ns,ns);
 	}
 
 	void clear(int ns)
@@ -86,39 +75,47 @@ private:
 	int n;
 	int ns;
 	checkpoint **x;
+	double **S0;
 	Random *rand;
+	Arena *arena;
 	double logtot;
 
 	void expQt(int n, double **Q, double t, double **etQ);
+	static void expQt2(double **Q, double t, double **etQ);
+	static bool expQt3(double **Q, double t, double **etQ);
 
 	inline double logpexp(double x, double l) const
 	{
 		return -l*x;
 	}
 
-	inline void append(vector<timepoint> *v, vector<timepoint> vv)
-	{
-		v->insert(v->end(),vv.begin(),vv.end());
-	}
-
 	inline void append(vector<timepoint> *v, checkpoint *x)
 	{
 		v->push_back(timepoint(x->time,x->state,true));
 	}
 
+	void fix(int i, int s);
+
 public:
 
-	Markov (int nstates, int npoints, double *t, double ***Q, double **S, bool *d, Random *r);
-	~Markov();
-	vector<timepoint> simulateProcess(double **Q, checkpoint *y, checkpoint *z) const;
-	vector<timepoint> simulateProcess();
+	// All working storage, including the paths returned by
+	// simulateProcess(), is taken from the arena and lasts until it is reset.
+	Markov (int nstates, int npoints, double *t, double ***Q, double **S, bool *d, Random *r, Arena *a);
+	void simulateProcess(double **Q, checkpoint *y, checkpoint *z, vector<timepoint> &v) const;
+	void simulateProcess(vector<timepoint> &v);
 	double simulateProcess(int segs, int *ec, double **et, int **es);
 	double logProcessProb(int segs, int *ec, double **et, int **es) const;
 	double logChainProb();
-	double logProb(vector<timepoint> v) const;
+	double logProb(const vector<timepoint> &v) const;
 	void collect();
 	void simulateChain();
 
+	// Conditions the process on being in state sa at checkpoint a and in
+	// state sb at checkpoint b, so that simulateProcess() resamples only
+	// the path between them. An end outside 0 to n-1 is left free. The
+	// transition matrices are reused; only the backward sums are redone.
+	void condition(int a, int sa, int b, int sb);
+
 // Implement Object
 	void write(ostream &os) const override;
 };
@@ -3,6 +3,7 @@
 #define ALUN_UTIL_OBJECT_H
 
 #include <string>
+#include <atomic>
 using std::string;
 using std::ostream;
 
@@ -12,7 +13,7 @@ namespace util{
 class Object : public Allocator
 {
 private:
-	static unsigned long indexcounter;
+	static std::atomic<unsigned long> indexcounter;
 	unsigned long index;
 
 public:
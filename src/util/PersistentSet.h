@@ -0,0 +1,229 @@
+// util/PersistentSet.h
+#ifndef ALUN_UTIL_PERSISTENTSET_H
+#define ALUN_UTIL_PERSISTENTSET_H
+
+#include <stdint.h>
+#include "Object.h"
+
+namespace util{
+/*
+	Set of objects that can be copied in constant time.
+	The set is held as a treap whose nodes are shared between copies and
+	never changed once made: add() and remove() copy only the path from the
+	root to the changed node, O(log n), and leave other sets sharing the
+	old nodes as they were.
+	Reference counts are not atomic, so sets that share nodes must only be
+	used by one thread at a time.
+*/
+class PersistentSet : public Object
+{
+private:
+	struct Node
+	{
+		Object *key;
+		uint64_t pri;
+		Node *left;
+		Node *right;
+		int refs;
+	};
+
+	Node *root;
+	int n;
+
+	static inline uint64_t priority(Object *k)
+	{
+		uint64_t z = (uint64_t) (uintptr_t) k + 0x9e3779b97f4a7c15ULL;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+	static inline bool before(Object *a, Object *b)
+	{
+		return (uintptr_t) a < (uintptr_t) b;
+	}
+
+	static inline Node *hold(Node *x)
+	{
+		if (x != 0)
+			x->refs++;
+		return x;
+	}
+
+	static void drop(Node *x)
+	{
+		while (x != 0 && --x->refs == 0)
+		{
+			drop(x->left);
+			Node *r = x->right;
+			delete x;
+			x = r;
+		}
+	}
+
+	// Takes over the references to l and r.
+	static inline Node *make(Node *x, Node *l, Node *r)
+	{
+		Node *y = new Node;
+		y->key = x->key;
+		y->pri = x->pri;
+		y->left = l;
+		y->right = r;
+		y->refs = 1;
+		return y;
+	}
+
+	static bool find(const Node *t, Object *k)
+	{
+		while (t != 0)
+		{
+			if (k == t->key)
+				return true;
+			t = before(k,t->key) ? t->left : t->right;
+		}
+		return false;
+	}
+
+	// The following return new references and leave t unchanged.
+
+	static void split(Node *t, Object *k, Node **l, Node **r)
+	{
+		if (t == 0)
+		{
+			*l = 0;
+			*r = 0;
+		}
+		else if (before(k,t->key))
+		{
+			Node *x = 0;
+			split(t->left,k,l,&x);
+			*r = make(t,x,hold(t->right));
+		}
+		else
+		{
+			Node *x = 0;
+			split(t->right,k,&x,r);
+			*l = make(t,hold(t->left),x);
+		}
+	}
+
+	static Node *insert(Node *t, Node *x)
+	{
+		if (t == 0 || x->pri > t->pri)
+		{
+			split(t,x->key,&x->left,&x->right);
+			return x;
+		}
+		if (before(x->key,t->key))
+			return make(t,insert(t->left,x),hold(t->right));
+		else
+			return make(t,hold(t->left),insert(t->right,x));
+	}
+
+	// Takes over the references to a and b.
+	static Node *merge(Node *a, Node *b)
+	{
+		if (a == 0)
+			return b;
+		if (b == 0)
+			return a;
+
+		Node *x = 0;
+		if (a->pri > b->pri)
+		{
+			x = make(a,hold(a->left),merge(hold(a->right),b));
+			drop(a);
+		}
+		else
+		{
+			x = make(b,merge(a,hold(b->left)),hold(b->right));
+			drop(b);
+		}
+		return x;
+	}
+
+	static Node *erase(Node *t, Object *k)
+	{
+		if (k == t->key)
+			return merge(hold(t->left),hold(t->right));
+		if (before(k,t->key))
+			return make(t,erase(t->left,k),hold(t->right));
+		else
+			return make(t,hold(t->left),erase(t->right,k));
+	}
+
+public:
+
+	PersistentSet()
+	{
+		root = 0;
+		n = 0;
+	}
+
+	~PersistentSet()
+	{
+		drop(root);
+	}
+
+	inline void clear()
+	{
+		drop(root);
+		root = 0;
+		n = 0;
+	}
+
+	// Makes this set equal to s, sharing its nodes.
+	inline void copy(const PersistentSet *s)
+	{
+		Node *r = hold(s->root);
+		drop(root);
+		root = r;
+		n = s->n;
+	}
+
+	inline bool got(Object *k) const
+	{
+		return find(root,k);
+	}
+
+	inline void add(Object *k)
+	{
+		if (find(root,k))
+			return;
+
+		Node *x = new Node;
+		x->key = k;
+		x->pri = priority(k);
+		x->left = 0;
+		x->right = 0;
+		x->refs = 1;
+
+		Node *r = insert(root,x);
+		drop(root);
+		root = r;
+		n++;
+	}
+
+	inline void remove(Object *k)
+	{
+		if (!find(root,k))
+			return;
+
+		Node *r = erase(root,k);
+		drop(root);
+		root = r;
+		n--;
+	}
+
+	inline int size() const
+	{
+		return n;
+	}
+
+	std::string className() const override
+	{
+		return "PersistentSet";
+	}
+};
+} // namespace util
+#endif // ALUN_UTIL_PERSISTENTSET_H
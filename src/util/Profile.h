@@ -0,0 +1,126 @@
+// util/Profile.h
+#ifndef ALUN_UTIL_PROFILE_H
+#define ALUN_UTIL_PROFILE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+namespace util{
+/*
+	Counters and timers for the sampler's hot paths.
+	A chain makes a Profile current on its thread, and the threads that
+	sample its episodes share it, so the counts are atomic. With no current
+	Profile each instrumented point costs a thread local load and a test.
+	Times from several threads are summed, so can exceed the wall time.
+*/
+class Profile
+{
+public:
+	enum Timer
+	{
+		SampleEpisodes,
+		SampleModel,
+		UpdateInsitu,
+		UpdateInCol,
+		UpdateSurveillanceTest,
+		UpdateClinicalTest,
+		UpdateOutCol,
+		UpdateAbx,
+		MarkovSetup,
+		ntimers
+	};
+
+	enum Counter
+	{
+		ExpQt,
+		ExpQtMemo,
+		EpisodeProposals,
+		EpisodeAccepts,
+		ncounters
+	};
+
+	// Times a scope against the current Profile, if there is one.
+	class Scope
+	{
+	private:
+		Profile *p;
+		Timer t;
+		std::chrono::steady_clock::time_point start;
+
+	public:
+		inline Scope(Timer x) : p(current()), t(x)
+		{
+			if (p != 0)
+				start = std::chrono::steady_clock::now();
+		}
+
+		inline ~Scope()
+		{
+			if (p != 0)
+				p->add(t, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+		}
+	};
+
+	// Makes a Profile current on this thread for the life of the object.
+	class Use
+	{
+	public:
+		inline Use(Profile *p)
+		{
+			current() = p;
+		}
+
+		inline ~Use()
+		{
+			current() = 0;
+		}
+	};
+
+	Profile();
+	void clear();
+
+	static const char *timerName(int i);
+	static const char *counterName(int i);
+
+	inline static Profile *&current()
+	{
+		static thread_local Profile *cur = 0;
+		return cur;
+	}
+
+	inline static void count(Counter c, uint64_t n = 1)
+	{
+		Profile *p = current();
+		if (p != 0)
+			p->counts[c].fetch_add(n, std::memory_order_relaxed);
+	}
+
+	inline void add(Timer t, uint64_t ns)
+	{
+		calls[t].fetch_add(1, std::memory_order_relaxed);
+		nanos[t].fetch_add(ns, std::memory_order_relaxed);
+	}
+
+	inline uint64_t getCount(int c) const
+	{
+		return counts[c].load();
+	}
+
+	inline uint64_t getCalls(int t) const
+	{
+		return calls[t].load();
+	}
+
+	inline double getSeconds(int t) const
+	{
+		return nanos[t].load() * 1e-9;
+	}
+
+private:
+	std::atomic<uint64_t> counts[ncounters];
+	std::atomic<uint64_t> calls[ntimers];
+	std::atomic<uint64_t> nanos[ntimers];
+};
+} // namespace util
+#endif // ALUN_UTIL_PROFILE_H
@@ -4,6 +4,8 @@
 
 #include "Object.h"
 #include <stdlib.h>
+#include <stdint.h>
+#include <vector>
 
 namespace util{
 class Random : public Object
@@ -56,6 +58,19 @@ public:
 	virtual double rpoisson(double l);
 	virtual int rint(int n, double *pi);
 
+/**
+	Generator state, for checkpoints. Generators that can't save their
+	state return false.
+*/
+	virtual bool getState(std::vector<uint64_t> &x) const
+	{
+		return false;
+	}
+
+	virtual bool setState(const std::vector<uint64_t> &x)
+	{
+		return false;
+	}
 };
 } // namespace util
 #endif // ALUN_UTIL_RANDOM_H
@@ -0,0 +1,103 @@
+// util/XoshiroRandom.h
+#ifndef ALUN_UTIL_XOSHIRORANDOM_H
+#define ALUN_UTIL_XOSHIRORANDOM_H
+
+#include <stdint.h>
+#include "Random.h"
+
+namespace util{
+/*
+	Pure C++ xoshiro256++ generator.
+	Unlike RRandom it does not call back into R, so independent instances
+	can be used from different threads. Streams for parallel chains are
+	made by seeding from one master seed and calling jump() once per stream.
+	Where many short streams are needed, as for the tasks of an episode
+	sweep or the simulations of a predictive check, stream k is instead
+	seeded with streamSeed(seed,k), which costs a few multiplies rather
+	than k jumps.
+	Raw draws are made a block at a time and handed out from a buffer, and
+	normal and exponential variates use the ziggurat method, so most draws
+	cost a buffer read, a table lookup and a multiply.
+*/
+class XoshiroRandom : public Random
+{
+private:
+	static const int nblock = 256;
+
+	// Generator state after making the buffered block, and before it.
+	uint64_t s[4];
+	uint64_t base[4];
+
+	uint64_t buf[nblock];
+	int pos;
+
+	static inline uint64_t rotl(const uint64_t x, int k)
+	{
+		return (x << k) | (x >> (64 - k));
+	}
+
+	inline uint64_t step()
+	{
+		const uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+		const uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+
+	void refill();
+
+	// Sets s to the state after the draws handed out so far, and empties
+	// the buffer.
+	void rewind();
+
+	double normalTail(int64_t h, int i);
+	double exponentialTail(uint64_t h, int i);
+
+public:
+	XoshiroRandom(uint64_t seed);
+	XoshiroRandom(uint64_t seed, int stream);
+
+	void setSeed(uint64_t seed);
+
+	// Seed for stream k of the streams keyed by seed. Each k gives an
+	// unrelated starting state.
+	static uint64_t streamSeed(uint64_t seed, uint64_t k);
+
+	// Advances the state by 2^128 draws, giving a non-overlapping stream.
+	void jump();
+
+	// The state is the generator state at the start of the current block
+	// and the position in it, so a restored generator gives the same draws.
+	bool getState(std::vector<uint64_t> &x) const override;
+	bool setState(const std::vector<uint64_t> &x) override;
+
+	inline uint64_t next()
+	{
+		if (pos == nblock)
+			refill();
+		return buf[pos++];
+	}
+
+	// Uniform on the open interval (0,1).
+	inline double runif() override
+	{
+		return ((next() >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+	}
+
+	using Random::rnorm;
+	using Random::rexp;
+	double rnorm() override;
+	double rexp() override;
+
+	std::string className() const override
+	{
+		return "XoshiroRandom";
+	}
+};
+} // namespace util
+#endif // ALUN_UTIL_XOSHIRORANDOM_H
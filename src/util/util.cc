@@ -19,4 +19,4 @@ std::ostream& operator<<(std::ostream &os, util::Object *x)
 
 /* Class constants */
 
-unsigned long util::Object::indexcounter = 0;
+std::atomic<unsigned long> util::Object::indexcounter(0);
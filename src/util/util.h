@@ -14,12 +14,16 @@
 	#include "Allocator.h"
 	#include "Object.h"
 	#include "Random.h"
+	#include "XoshiroRandom.h"
 	#include "Integer.h"
 	#include "Vector.h"
 	#include "Map.h"
+	#include "PersistentSet.h"
 	#include "IntMap.h"
 	#include "List.h"
 	#include "SortedList.h"
+	#include "Arena.h"
+	#include "Profile.h"
 	#include "Markov.h"
 
 	namespace util
@@ -0,0 +1,48 @@
+#include "util/util.h"
+
+namespace util {
+
+Profile::Profile()
+{
+    clear();
+}
+
+void Profile::clear()
+{
+    for (int i=0; i<ncounters; i++)
+        counts[i] = 0;
+    for (int i=0; i<ntimers; i++)
+    {
+        calls[i] = 0;
+        nanos[i] = 0;
+    }
+}
+
+const char *Profile::timerName(int i)
+{
+    static const char *names[ntimers] = {
+        "sampleEpisodes",
+        "sampleModel",
+        "update.Insitu",
+        "update.InCol",
+        "update.SurveillanceTest",
+        "update.ClinicalTest",
+        "update.OutCol",
+        "update.Abx",
+        "Markov"
+    };
+    return names[i];
+}
+
+const char *Profile::counterName(int i)
+{
+    static const char *names[ncounters] = {
+        "expQt",
+        "expQt.memo",
+        "episodes",
+        "episodes.accepted"
+    };
+    return names[i];
+}
+
+} // namespace util
@@ -0,0 +1,249 @@
+#include "util/util.h"
+#include <math.h>
+
+namespace util {
+
+namespace {
+
+// Ziggurat tables after Marsaglia and Tsang (2000), "The ziggurat method
+// for generating random variables", scaled for 56 bit draws. The layer
+// index comes from the low byte of a draw and the abscissa from the rest,
+// so the two are independent.
+struct Ziggurat
+{
+    int64_t kn[128];
+    double wn[128];
+    double fn[128];
+
+    uint64_t ke[256];
+    double we[256];
+    double fe[256];
+
+    Ziggurat()
+    {
+        const double m1 = 36028797018963968.0;  // 2^55
+        const double m2 = 72057594037927936.0;  // 2^56
+
+        double dn = 3.442619855899;
+        double tn = dn;
+        double vn = 9.91256303526217e-3;
+        double q = vn / exp(-0.5*dn*dn);
+        kn[0] = (int64_t) ((dn/q)*m1);
+        kn[1] = 0;
+        wn[0] = q/m1;
+        wn[127] = dn/m1;
+        fn[0] = 1.0;
+        fn[127] = exp(-0.5*dn*dn);
+        for (int i=126; i>=1; i--)
+        {
+            dn = sqrt(-2.0*log(vn/dn + exp(-0.5*dn*dn)));
+            kn[i+1] = (int64_t) ((dn/tn)*m1);
+            tn = dn;
+            fn[i] = exp(-0.5*dn*dn);
+            wn[i] = dn/m1;
+        }
+
+        double de = 7.697117470131487;
+        double te = de;
+        double ve = 3.949659822581572e-3;
+        q = ve / exp(-de);
+        ke[0] = (uint64_t) ((de/q)*m2);
+        ke[1] = 0;
+        we[0] = q/m2;
+        we[255] = de/m2;
+        fe[0] = 1.0;
+        fe[255] = exp(-de);
+        for (int i=254; i>=1; i--)
+        {
+            de = -log(ve/de + exp(-de));
+            ke[i+1] = (uint64_t) ((de/te)*m2);
+            te = de;
+            fe[i] = exp(-de);
+            we[i] = de/m2;
+        }
+    }
+};
+
+const Ziggurat zig;
+
+// The splitmix64 output function.
+inline uint64_t splitmix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+} // namespace
+
+XoshiroRandom::XoshiroRandom(uint64_t seed)
+{
+    setSeed(seed);
+}
+
+XoshiroRandom::XoshiroRandom(uint64_t seed, int stream)
+{
+    setSeed(seed);
+    for (int i=0; i<stream; i++)
+        jump();
+}
+
+void XoshiroRandom::setSeed(uint64_t seed)
+{
+    // Fill the state with splitmix64 so that nearby seeds give unrelated states.
+    uint64_t z = seed;
+    for (int i=0; i<4; i++)
+    {
+        z += 0x9e3779b97f4a7c15ULL;
+        s[i] = splitmix(z);
+    }
+    refill();
+}
+
+uint64_t XoshiroRandom::streamSeed(uint64_t seed, uint64_t k)
+{
+    return splitmix(seed ^ splitmix(k + 0x9e3779b97f4a7c15ULL));
+}
+
+void XoshiroRandom::refill()
+{
+    for (int i=0; i<4; i++)
+        base[i] = s[i];
+    for (int i=0; i<nblock; i++)
+        buf[i] = step();
+    pos = 0;
+}
+
+void XoshiroRandom::rewind()
+{
+    for (int i=0; i<4; i++)
+        s[i] = base[i];
+    for (int i=0; i<pos; i++)
+        step();
+    pos = nblock;
+}
+
+bool XoshiroRandom::getState(std::vector<uint64_t> &x) const
+{
+    x.assign(base, base+4);
+    x.push_back(pos);
+    return true;
+}
+
+bool XoshiroRandom::setState(const std::vector<uint64_t> &x)
+{
+    if (x.size() != 4 && x.size() != 5)
+        return false;
+    if (x.size() == 5 && x[4] > (uint64_t) nblock)
+        return false;
+    for (int i=0; i<4; i++)
+        s[i] = x[i];
+    refill();
+    if (x.size() == 5)
+        pos = x[4];
+    return true;
+}
+
+void XoshiroRandom::jump()
+{
+    static const uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+
+    rewind();
+
+    uint64_t s0 = 0;
+    uint64_t s1 = 0;
+    uint64_t s2 = 0;
+    uint64_t s3 = 0;
+
+    for (int i=0; i<4; i++)
+        for (int b=0; b<64; b++)
+        {
+            if (JUMP[i] & ((uint64_t) 1) << b)
+            {
+                s0 ^= s[0];
+                s1 ^= s[1];
+                s2 ^= s[2];
+                s3 ^= s[3];
+            }
+            step();
+        }
+
+    s[0] = s0;
+    s[1] = s1;
+    s[2] = s2;
+    s[3] = s3;
+
+    refill();
+}
+
+double XoshiroRandom::rnorm()
+{
+    uint64_t u = next();
+    int i = u & 127;
+    int64_t h = ((int64_t) u) >> 8;
+    if ((h < 0 ? -h : h) < zig.kn[i])
+        return h * zig.wn[i];
+    return normalTail(h,i);
+}
+
+double XoshiroRandom::normalTail(int64_t h, int i)
+{
+    const double r = 3.442619855899;
+
+    for (;;)
+    {
+        double x = h * zig.wn[i];
+
+        if (i == 0)
+        {
+            double y = 0;
+            do
+            {
+                x = -log(runif()) / r;
+                y = -log(runif());
+            }
+            while (y+y < x*x);
+            return h > 0 ? r+x : -r-x;
+        }
+
+        if (zig.fn[i] + runif() * (zig.fn[i-1] - zig.fn[i]) < exp(-0.5*x*x))
+            return x;
+
+        uint64_t u = next();
+        i = u & 127;
+        h = ((int64_t) u) >> 8;
+        if ((h < 0 ? -h : h) < zig.kn[i])
+            return h * zig.wn[i];
+    }
+}
+
+double XoshiroRandom::rexp()
+{
+    uint64_t u = next();
+    int i = u & 255;
+    uint64_t h = u >> 8;
+    if (h < zig.ke[i])
+        return h * zig.we[i];
+    return exponentialTail(h,i);
+}
+
+double XoshiroRandom::exponentialTail(uint64_t h, int i)
+{
+    for (;;)
+    {
+        if (i == 0)
+            return 7.697117470131487 - log(runif());
+
+        double x = h * zig.we[i];
+        if (zig.fe[i] + runif() * (zig.fe[i-1] - zig.fe[i]) < exp(-x))
+            return x;
+
+        uint64_t u = next();
+        i = u & 255;
+        h = u >> 8;
+        if (h < zig.ke[i])
+            return h * zig.we[i];
+    }
+}
+
+} // namespace util
@@ -38,6 +38,26 @@ SEXP model2R(const lognormal::LogNormalModel * model)
     );
 }
 
+SEXP values2R(const Parameters * P, const std::vector<double> &values){
+    Rcpp::NumericVector rtn(std::begin(values), std::end(values));
+    rtn.attr("names") = P->paramNames();
+    return rtn;
+}
+
+SEXP model2R(const lognormal::LogNormalModel * model, const std::vector< std::vector<double> > &values)
+{
+    // Same structure as model2R(model) but with values saved earlier,
+    // in the component order of modelValues().
+    return Rcpp::List::create(
+        _["Insitu"] = values2R(model->getInsituParams(), values[0]),
+        _["SurveillanceTest"] = values2R(model->getSurveillanceTestParams(), values[1]),
+        _["ClinicalTest"] = values2R(model->getClinicalTestParams(), values[2]),
+        _["OutCol"] = values2R(model->getOutColParams(), values[3]),
+        _["InCol"] = values2R(model->getInColParams(), values[4]),
+        _["Abx"] = values2R(model->getAbxParams(), values[5])
+    );
+}
+
 template <> SEXP Rcpp::wrap(const lognormal::LogNormalModel& model)
 {
     return model2R(&model);
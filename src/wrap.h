@@ -69,12 +69,13 @@ namespace lognormal{
     DECLARE_POINTER(LogNormalModel);
     DECLARE_POINTER(MixedICP);
     DECLARE_POINTER(MixedModel);
-    // DECLARE_POINTER(MultiUnitAbxIcp);
+    DECLARE_POINTER(MultiUnitAbxICP);
 }
 
 
 SEXP params2R(const Parameters *);
 SEXP model2R(const lognormal::LogNormalModel * );
+SEXP model2R(const lognormal::LogNormalModel *, const std::vector< std::vector<double> > &);
 // SEXP HistoryLink2R(const infect::HistoryLink *);
 
 typedef double (models::UnitLinkedModel::*LogLikelihood_SH)(infect::SystemHistory*);